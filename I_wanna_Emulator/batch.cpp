@@ -0,0 +1,79 @@
+#include "batch.h"
+
+#include <algorithm>
+
+namespace iwemu
+{
+	// copy of an array, with a cache line of room on both sides
+	template <typename T>
+	static T* padded_copy(std::vector<T>& storage, const T* src, size_t n)
+	{
+		size_t pad = (64 + sizeof(T) - 1) / sizeof(T);
+		storage.assign(n + 2 * pad, T());
+		std::copy(src, src + n, storage.begin() + pad);
+		return storage.data() + pad;
+	}
+
+	SceneBatch::SceneBatch(
+		int grav_dir,
+		const Hitbox* solids, size_t solidsC,
+		const Segment* segments, size_t segmentsC,
+		const BBox* collidables, size_t collidablesC,
+		size_t scenesC, unsigned int threads
+	) : _pool(threads), _collidablesC(collidablesC)
+	{
+		this->_lanes.assign(scenesC, 0);
+		if (!scenesC) return;
+		// first scene builds the index, the rest are made by the threads that will run them,
+		// so their memory is allocated by those threads
+		Lane* first = 0;
+		auto make = [&](size_t i)
+		{
+			Lane* lane = new Lane();
+			lane->solids = padded_copy(lane->solids_storage, solids, solidsC);
+			lane->segments = padded_copy(lane->segments_storage, segments, segmentsC);
+			lane->collidables = padded_copy(lane->collidables_storage, collidables, collidablesC);
+			if (first)
+				lane->scene = new SolidScene(*first->scene, grav_dir,
+					lane->solids, solidsC, lane->segments, segmentsC, lane->collidables, collidablesC);
+			else
+				lane->scene = new SolidScene(grav_dir,
+					lane->solids, solidsC, lane->segments, segmentsC, lane->collidables, collidablesC);
+			lane->result = { 0, collidablesC, -1 };
+			this->_lanes[i] = lane;
+		};
+		make(0);
+		first = this->_lanes[0];
+		this->_pool.run(scenesC - 1, [&](size_t i) { make(i + 1); });
+	}
+
+	SceneBatch::~SceneBatch()
+	{
+		for (size_t i = 0; i < this->_lanes.size(); i++)
+		{
+			delete this->_lanes[i]->scene;
+			delete this->_lanes[i];
+		}
+	}
+
+	void SceneBatch::step(unsigned int frames, const Control& control)
+	{
+		this->_pool.run(this->_lanes.size(), [&](size_t i)
+		{
+			Lane& lane = *this->_lanes[i];
+			SolidScene& scene = *lane.scene;
+			for (unsigned int f = 0; f < frames; f++)
+			{
+				if (control) control(i, scene, lane.collidables);
+				scene.update();
+				lane.result.frames++;
+				size_t alive = 0;
+				for (size_t k = 0; k < this->_collidablesC; k++)
+					alive += scene.alive[k];
+				if (alive < lane.result.alive && lane.result.first_death < 0)
+					lane.result.first_death = (long long)lane.result.frames - 1;
+				lane.result.alive = alive;
+			}
+		});
+	}
+}
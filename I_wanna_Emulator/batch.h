@@ -0,0 +1,71 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "solids.h"
+#include "threadpool.h"
+
+namespace iwemu
+{
+	// many copies of one room, stepped at once on all cores.
+	// static objects are indexed once, and every copy uses that index.
+	// each copy has its own objects, collidables and grid of moving objects, all of it kept
+	// at least a cache line away from the others, so threads running them don't share lines
+	class SceneBatch
+	{
+	public:
+		struct Result
+		{
+			unsigned long long frames;
+			// collidables still alive after the last frame
+			size_t alive;
+			// frame when a collidable died for the first time, -1 if none did
+			long long first_death;
+		};
+		// called before every update() of a scene, on the thread running it.
+		// should only touch that scene and its collidables
+		typedef std::function<void(size_t scene, SolidScene& solid_scene, BBox* collidables)> Control;
+
+		SceneBatch(
+			int grav_dir,
+			const Hitbox* solids, size_t solidsC,
+			const Segment* segments, size_t segmentsC,
+			const BBox* collidables, size_t collidablesC,
+			size_t scenesC, unsigned int threads = 0
+		);
+		~SceneBatch();
+
+		size_t size() const { return this->_lanes.size(); }
+		unsigned int threads() const { return this->_pool.size(); }
+		SolidScene& scene(size_t i) { return *this->_lanes[i]->scene; }
+		Hitbox* solids(size_t i) { return this->_lanes[i]->solids; }
+		Segment* segments(size_t i) { return this->_lanes[i]->segments; }
+		BBox* collidables(size_t i) { return this->_lanes[i]->collidables; }
+		const Result& result(size_t i) const { return this->_lanes[i]->result; }
+		// for jobs of one's own. with as many scenes as threads, thread w can use scene(w)
+		ThreadPool& pool() { return this->_pool; }
+
+		// steps every scene by frames, control can be empty
+		void step(unsigned int frames, const Control& control);
+
+	private:
+		// everything of one scene
+		struct Lane
+		{
+			char before[64];
+			std::vector<Hitbox> solids_storage;
+			std::vector<Segment> segments_storage;
+			std::vector<BBox> collidables_storage;
+			Hitbox* solids;
+			Segment* segments;
+			BBox* collidables;
+			SolidScene* scene;
+			Result result;
+			char after[64];
+		};
+
+		ThreadPool _pool;
+		std::vector<Lane*> _lanes;
+		size_t _collidablesC;
+	};
+}
@@ -1,9 +1,205 @@
 #include "bitmask.h"
 
+#include <math.h>
+
 namespace iwemu
 {
-	bool intersect(Bitmask& mask, Hitbox& hbox)
+	static const double pi = 3.14159265358979323846;
+
+	// n lowest bits set, n in [0, 64]
+	static inline uint64_t low_bits(unsigned int n)
+	{
+		return n >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+	}
+
+	// 64 pixels of a row starting from pixel px, zeros past the end of the row
+	static inline uint64_t window(const uint64_t* row, size_t stride, unsigned int px)
+	{
+		size_t w = px >> 6;
+		unsigned int s = px & 63;
+		uint64_t bits = row[w] >> s;
+		if (s && w + 1 < stride) bits |= row[w + 1] << (64 - s);
+		return bits;
+	}
+
+	Bitmask make_bitmask(const Hitbox& place)
+	{
+		Bitmask mask;
+		static_cast<Hitbox&>(mask) = place;
+		mask.stride = (place.width + 63) / 64;
+		mask.bits.assign(mask.stride * place.height, 0);
+		mask.rotation = 0.0;
+		return mask;
+	}
+
+	void set_pixel(Bitmask& mask, unsigned int px, unsigned int py, bool value)
+	{
+		if (px >= mask.width || py >= mask.height) return;
+		uint64_t& word = mask.bits[py * mask.stride + (px >> 6)];
+		uint64_t bit = (uint64_t)1 << (px & 63);
+		if (value) word |= bit;
+		else word &= ~bit;
+	}
+
+	// mask placed with its top left pixel at (mx, my) against hbox
+	static bool overlap(const Bitmask& mask, int mx, int my, const Hitbox& hbox)
+	{
+		if (!intersect(mx, mask.width, hbox.x, hbox.width) || !intersect(my, mask.height, hbox.y, hbox.height)) return false;
+		// overlap, in pixels of the mask
+		unsigned int x1 = hbox.x > mx ? hbox.x - mx : 0;
+		unsigned int y1 = hbox.y > my ? hbox.y - my : 0;
+		unsigned int x2 = right(hbox) < mx + (int)mask.width ? right(hbox) - mx : mask.width;
+		unsigned int y2 = bottom(hbox) < my + (int)mask.height ? bottom(hbox) - my : mask.height;
+		// a box of zero width or height covers no pixels, and x2 - 1 below would be a word before x1
+		if (x1 >= x2 || y1 >= y2) return false;
+		size_t w1 = x1 >> 6, w2 = (x2 - 1) >> 6;
+		uint64_t first = ~low_bits(x1 & 63);
+		uint64_t last = low_bits(x2 - (w2 << 6));
+		for (unsigned int py = y1; py < y2; py++)
+		{
+			const uint64_t* r = row(mask, py);
+			if (w1 == w2)
+			{
+				if (r[w1] & first & last) return true;
+				continue;
+			}
+			if ((r[w1] & first) || (r[w2] & last)) return true;
+			for (size_t w = w1 + 1; w < w2; w++)
+			{
+				if (r[w]) return true;
+			}
+		}
+		return false;
+	}
+
+	// mask1 placed at (m1x, m1y) against mask2 placed at (m2x, m2y)
+	static bool overlap(const Bitmask& mask1, int m1x, int m1y, const Bitmask& mask2, int m2x, int m2y)
+	{
+		if (!intersect(m1x, mask1.width, m2x, mask2.width) || !intersect(m1y, mask1.height, m2y, mask2.height)) return false;
+		// overlap, in pixels of the scene
+		int x1 = m1x > m2x ? m1x : m2x;
+		int y1 = m1y > m2y ? m1y : m2y;
+		int x2 = m1x + (int)mask1.width < m2x + (int)mask2.width ? m1x + (int)mask1.width : m2x + (int)mask2.width;
+		int y2 = m1y + (int)mask1.height < m2y + (int)mask2.height ? m1y + (int)mask1.height : m2y + (int)mask2.height;
+		unsigned int w = x2 - x1;
+		for (int y = y1; y < y2; y++)
+		{
+			const uint64_t* r1 = row(mask1, y - m1y);
+			const uint64_t* r2 = row(mask2, y - m2y);
+			for (unsigned int k = 0; k < w; k += 64)
+			{
+				uint64_t bits =
+					window(r1, mask1.stride, x1 - m1x + k) &
+					window(r2, mask2.stride, x1 - m2x + k);
+				if (w - k < 64) bits &= low_bits(w - k);
+				if (bits) return true;
+			}
+		}
+		return false;
+	}
+
+	bool intersect(const Bitmask& mask, const Hitbox& hbox)
+	{
+		return overlap(mask, mask.x, mask.y, hbox);
+	}
+
+	bool intersect(const Bitmask& mask1, const Bitmask& mask2)
+	{
+		return overlap(mask1, mask1.x, mask1.y, mask2, mask2.x, mask2.y);
+	}
+
+	// mask rotated around (ox, oy), cropped to its pixels, x, y relative to (ox, oy)
+	static Bitmask rotate(const Bitmask& mask, int ox, int oy, double angle)
+	{
+		double c = cos(angle), s = sin(angle);
+		// bounds of the rotated rectangle
+		double x1 = 0.0, y1 = 0.0, x2 = 0.0, y2 = 0.0;
+		for (int k = 0; k < 4; k++)
+		{
+			double u = (k & 1 ? (double)mask.width : 0.0) - ox;
+			double v = (k & 2 ? (double)mask.height : 0.0) - oy;
+			double x = u * c + v * s, y = -u * s + v * c;
+			if (k == 0 || x < x1) x1 = x;
+			if (k == 0 || y < y1) y1 = y;
+			if (k == 0 || x > x2) x2 = x;
+			if (k == 0 || y > y2) y2 = y;
+		}
+		Hitbox place = { (int)floor(x1), (int)floor(y1), 0, 0, 0, 0 };
+		place.width = (unsigned int)((int)ceil(x2) - place.x);
+		place.height = (unsigned int)((int)ceil(y2) - place.y);
+
+		// every pixel takes the one its center comes from
+		Bitmask full = make_bitmask(place);
+		unsigned int px1 = place.width, py1 = place.height, px2 = 0, py2 = 0;
+		for (unsigned int py = 0; py < place.height; py++)
+		{
+			for (unsigned int px = 0; px < place.width; px++)
+			{
+				double x = place.x + (double)px + 0.5, y = place.y + (double)py + 0.5;
+				double u = x * c - y * s + ox, v = x * s + y * c + oy;
+				if (u < 0.0 || v < 0.0 || u >= mask.width || v >= mask.height) continue;
+				if (!get_pixel(mask, (unsigned int)u, (unsigned int)v)) continue;
+				set_pixel(full, px, py, true);
+				if (px < px1) px1 = px;
+				if (py < py1) py1 = py;
+				if (px + 1 > px2) px2 = px + 1;
+				if (py + 1 > py2) py2 = py + 1;
+			}
+		}
+		if (px1 >= px2) return make_bitmask({ 0, 0, 0, 0, 0, 0 });
+
+		Bitmask tight = make_bitmask({ place.x + (int)px1, place.y + (int)py1, px2 - px1, py2 - py1, 0, 0 });
+		for (unsigned int py = py1; py < py2; py++)
+		{
+			for (unsigned int px = px1; px < px2; px++)
+			{
+				if (get_pixel(full, px, py)) set_pixel(tight, px - px1, py - py1, true);
+			}
+		}
+		tight.rotation = angle * 180.0 / pi;
+		return tight;
+	}
+
+	RotationCache make_rotation_cache(const Bitmask& mask, int origin_x, int origin_y, unsigned int steps)
+	{
+		RotationCache cache;
+		cache.origin_x = origin_x;
+		cache.origin_y = origin_y;
+		if (steps == 0) steps = 1;
+		cache.masks.reserve(steps);
+		for (unsigned int k = 0; k < steps; k++)
+			cache.masks.push_back(rotate(mask, origin_x, origin_y, 2.0 * pi * k / steps));
+		return cache;
+	}
+
+	const Bitmask& rotated(const RotationCache& cache, double rotation)
+	{
+		static const Bitmask nothing = make_bitmask({ 0, 0, 0, 0, 0, 0 });
+		if (cache.masks.empty()) return nothing;
+		long steps = (long)cache.masks.size();
+		long k = lround(rotation * steps / 360.0) % steps;
+		if (k < 0) k += steps;
+		return cache.masks[k];
+	}
+
+	Hitbox rotated_hitbox(const RotationCache& cache, const Bitmask& mask)
+	{
+		if (cache.masks.empty()) return mask;
+		const Bitmask& r = rotated(cache, mask.rotation);
+		return { mask.x + cache.origin_x + r.x, mask.y + cache.origin_y + r.y, r.width, r.height, mask.dx, mask.dy };
+	}
+
+	bool intersect(const RotationCache& cache, const Bitmask& mask, const Hitbox& hbox)
+	{
+		if (cache.masks.empty()) return intersect(mask, hbox);
+		const Bitmask& r = rotated(cache, mask.rotation);
+		return overlap(r, mask.x + cache.origin_x + r.x, mask.y + cache.origin_y + r.y, hbox);
+	}
+
+	bool intersect(const RotationCache& cache, const Bitmask& mask1, const Bitmask& mask2)
 	{
-		// todo
+		if (cache.masks.empty()) return intersect(mask1, mask2);
+		const Bitmask& r = rotated(cache, mask1.rotation);
+		return overlap(r, mask1.x + cache.origin_x + r.x, mask1.y + cache.origin_y + r.y, mask2, mask2.x, mask2.y);
 	}
-}
\ No newline at end of file
+}
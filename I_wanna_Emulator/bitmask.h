@@ -1,16 +1,52 @@
 #pragma once
 
-// vector<bool> suits most for this
+#include <stdint.h>
 #include <vector>
 #include "hitbox.h"
 
 namespace iwemu
 {
+	// hitbox part is where the mask is, x, y - top left pixel.
+	// pixels are packed in rows of 64-bit words, so a whole word of them is tested with one and.
+	// pixel (px, py) is bit px % 64 of word py * stride + px / 64,
+	// bits past the width are always zero
 	struct Bitmask : Hitbox
 	{
-		std::vector<std::vector<bool>> mask;
+		std::vector<uint64_t> bits;
+		size_t stride;	// words in a row
+		// degrees, counterclockwise on screen like image_angle. only used with a RotationCache
 		double rotation;
 	};
 
-	bool intersect(Bitmask& mask, Hitbox& hbox);
-}
\ No newline at end of file
+	// rotated copies of a mask, rasterized once, one for each of steps angles.
+	// each copy is cropped to its pixels, its x, y are relative to the rotation origin.
+	// a cache with no copies (default made) leaves masks as they are
+	struct RotationCache
+	{
+		std::vector<Bitmask> masks;
+		// origin, in pixels of the unrotated mask
+		int origin_x = 0, origin_y = 0;
+	};
+
+	// empty mask over place
+	Bitmask make_bitmask(const Hitbox& place);
+
+	inline const uint64_t* row(const Bitmask& mask, unsigned int py) { return mask.bits.data() + py * mask.stride; }
+	inline bool get_pixel(const Bitmask& mask, unsigned int px, unsigned int py)
+	{
+		return (row(mask, py)[px >> 6] >> (px & 63)) & 1;
+	}
+	void set_pixel(Bitmask& mask, unsigned int px, unsigned int py, bool value);
+
+	bool intersect(const Bitmask& mask, const Hitbox& hbox);
+	bool intersect(const Bitmask& mask1, const Bitmask& mask2);
+
+	RotationCache make_rotation_cache(const Bitmask& mask, int origin_x, int origin_y, unsigned int steps = 360);
+	// cached copy closest to the rotation, one with no pixels if the cache is empty
+	const Bitmask& rotated(const RotationCache& cache, double rotation);
+	// tight box around mask rotated by mask.rotation, mask.x, mask.y being where the unrotated mask is
+	Hitbox rotated_hitbox(const RotationCache& cache, const Bitmask& mask);
+	// same as intersect, but with mask rotated by mask.rotation, using the cache made from it
+	bool intersect(const RotationCache& cache, const Bitmask& mask, const Hitbox& hbox);
+	bool intersect(const RotationCache& cache, const Bitmask& mask1, const Bitmask& mask2);
+}
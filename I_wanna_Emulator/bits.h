@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace iwemu
+{
+	// a / b rounded down, for a left of the origin too. b has to be more than 0
+	inline int64_t floor_div(int64_t a, int64_t b)
+	{
+		return a >= 0 ? a / b : -((-a + b - 1) / b);
+	}
+
+	// index of the lowest set bit, v can't be 0
+	inline int low_bit(uint64_t v)
+	{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+		unsigned long i;
+		_BitScanForward64(&i, v);
+		return (int)i;
+#elif defined(_MSC_VER)
+		unsigned long i;
+		if (_BitScanForward(&i, (unsigned long)v)) return (int)i;
+		_BitScanForward(&i, (unsigned long)(v >> 32));
+		return (int)i + 32;
+#else
+		return __builtin_ctzll(v);
+#endif
+	}
+
+	// index of the highest set bit, v can't be 0
+	inline int high_bit(uint64_t v)
+	{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+		unsigned long i;
+		_BitScanReverse64(&i, v);
+		return (int)i;
+#elif defined(_MSC_VER)
+		unsigned long i;
+		if (_BitScanReverse(&i, (unsigned long)(v >> 32))) return (int)i + 32;
+		_BitScanReverse(&i, (unsigned long)v);
+		return (int)i;
+#else
+		return 63 - __builtin_clzll(v);
+#endif
+	}
+}
@@ -0,0 +1,103 @@
+#include "broadphase.h"
+
+#include <algorithm>
+
+namespace iwemu
+{
+	static bool by_left(const Broadphase::Entry& a, const Broadphase::Entry& b)
+	{
+		return a.x1 < b.x1;
+	}
+
+	static bool by_mover(const Broadphase::Pair& a, const Broadphase::Pair& b)
+	{
+		return a.mover < b.mover || (a.mover == b.mover && a.collidable < b.collidable);
+	}
+
+	// drops entries that end before x, and pairs e with what is left
+	template <typename F>
+	static void sweep(std::vector<const Broadphase::Entry*>& active, const Broadphase::Entry& e, F pair)
+	{
+		for (size_t i = 0; i < active.size();)
+		{
+			const Broadphase::Entry& a = *active[i];
+			if (a.x2 < e.x1)
+			{	// it's to the left of everything that comes next
+				active[i] = active.back();
+				active.pop_back();
+				continue;
+			}
+			if (a.y1 <= e.y2 && e.y1 <= a.y2)
+				pair(a);
+			i++;
+		}
+	}
+
+	void Broadphase::reserve(size_t moversC, size_t collidablesC)
+	{
+		this->_entries.reserve(moversC + collidablesC);
+		this->_active_movers.reserve(moversC);
+		this->_active_collidables.reserve(collidablesC);
+		this->_pairs.reserve(moversC + collidablesC);
+		this->_candidates.reserve(moversC + collidablesC);
+		this->_offsets.reserve(moversC + 1);
+	}
+
+	void Broadphase::clear()
+	{
+		this->_entries.clear();
+	}
+
+	void Broadphase::add_mover(unsigned int id, const Hitbox& box)
+	{
+		this->_entries.push_back({ box.x, right(box), box.y, bottom(box), id, true });
+	}
+
+	void Broadphase::add_collidable(unsigned int id, const Hitbox& box)
+	{
+		this->_entries.push_back({ box.x, right(box), box.y, bottom(box), id, false });
+	}
+
+	void Broadphase::run(size_t moversC)
+	{
+		std::sort(this->_entries.begin(), this->_entries.end(), by_left);
+		this->_active_movers.clear();
+		this->_active_collidables.clear();
+		this->_pairs.clear();
+		for (size_t i = 0; i < this->_entries.size(); i++)
+		{
+			const Entry& e = this->_entries[i];
+			std::vector<Pair>& pairs = this->_pairs;
+			if (e.mover)
+			{
+				sweep(this->_active_collidables, e, [&](const Entry& c) { pairs.push_back({ e.id, c.id }); });
+				sweep(this->_active_movers, e, [](const Entry&) {});
+				this->_active_movers.push_back(&e);
+			}
+			else
+			{
+				sweep(this->_active_movers, e, [&](const Entry& m) { pairs.push_back({ m.id, e.id }); });
+				sweep(this->_active_collidables, e, [](const Entry&) {});
+				this->_active_collidables.push_back(&e);
+			}
+		}
+
+		// group by mover, keeping collidables in the order the scene processes them
+		std::sort(this->_pairs.begin(), this->_pairs.end(), by_mover);
+		this->_offsets.assign(moversC + 1, 0);
+		this->_candidates.resize(this->_pairs.size());
+		for (size_t i = 0; i < this->_pairs.size(); i++)
+		{
+			this->_offsets[this->_pairs[i].mover + 1]++;
+			this->_candidates[i] = this->_pairs[i].collidable;
+		}
+		for (size_t m = 0; m < moversC; m++)
+			this->_offsets[m + 1] += this->_offsets[m];
+	}
+
+	const unsigned int* Broadphase::candidates(unsigned int mover, size_t& count) const
+	{
+		count = this->_offsets[mover + 1] - this->_offsets[mover];
+		return this->_candidates.data() + this->_offsets[mover];
+	}
+}
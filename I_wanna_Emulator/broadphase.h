@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include "hitbox.h"
+
+namespace iwemu
+{
+	// sweep and prune. boxes of movers and collidables are sorted by their left side,
+	// then swept from left to right, and every mover gets a list of collidables
+	// whose boxes overlap its own
+	class Broadphase
+	{
+	public:
+		struct Entry
+		{
+			int x1, x2, y1, y2;
+			unsigned int id;
+			bool mover;
+		};
+		struct Pair
+		{
+			unsigned int mover, collidable;
+		};
+
+		// makes room up front, so pairing doesn't allocate while the scene runs
+		void reserve(size_t moversC, size_t collidablesC);
+		void clear();
+		void add_mover(unsigned int id, const Hitbox& box);
+		void add_collidable(unsigned int id, const Hitbox& box);
+		// pairs up everything added since clear(). mover ids have to be below moversC
+		void run(size_t moversC);
+		// collidables that can touch the mover, in increasing order
+		const unsigned int* candidates(unsigned int mover, size_t& count) const;
+
+	private:
+		std::vector<Entry> _entries;
+		std::vector<const Entry*> _active_movers;
+		std::vector<const Entry*> _active_collidables;
+		std::vector<Pair> _pairs;
+		// candidates of mover m are in [offsets[m], offsets[m + 1])
+		std::vector<unsigned int> _offsets;
+		std::vector<unsigned int> _candidates;
+	};
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+namespace iwemu
+{
+	// fixed-point coordinate, 1/65536 of a pixel. everything on it is integer math,
+	// so it gives the same bits with every compiler and cpu.
+	// ints convert to it implicitly, doubles only explicitly, so an accidental double
+	// in the physics doesn't compile
+	struct Fixed
+	{
+		static const int FRAC_BITS = 16;
+		static const int64_t ONE = (int64_t)1 << FRAC_BITS;
+
+		int64_t raw;
+
+		Fixed() = default;
+		Fixed(int v) : raw((int64_t)v * ONE) {}
+		Fixed(unsigned int v) : raw((int64_t)v * ONE) {}
+		explicit Fixed(double v) : raw((int64_t)llround(v * ONE)) {}
+		explicit operator double() const { return (double)this->raw / ONE; }
+
+		static Fixed from_raw(int64_t raw) { Fixed f; f.raw = raw; return f; }
+
+		Fixed& operator+=(Fixed o) { this->raw += o.raw; return *this; }
+		Fixed& operator-=(Fixed o) { this->raw -= o.raw; return *this; }
+		Fixed& operator*=(Fixed o) { this->raw = this->raw * o.raw / ONE; return *this; }
+	};
+
+	inline Fixed operator-(Fixed a) { return Fixed::from_raw(-a.raw); }
+	inline Fixed operator+(Fixed a, Fixed b) { return Fixed::from_raw(a.raw + b.raw); }
+	inline Fixed operator-(Fixed a, Fixed b) { return Fixed::from_raw(a.raw - b.raw); }
+	// meant for speeds and factors, two positions multiplied can overflow
+	inline Fixed operator*(Fixed a, Fixed b) { return Fixed::from_raw(a.raw * b.raw / Fixed::ONE); }
+	inline Fixed operator*(Fixed a, int b) { return Fixed::from_raw(a.raw * b); }
+	inline Fixed operator*(int a, Fixed b) { return Fixed::from_raw(a * b.raw); }
+	inline Fixed operator/(Fixed a, Fixed b) { return Fixed::from_raw(a.raw * Fixed::ONE / b.raw); }
+	inline Fixed operator/(Fixed a, int b) { return Fixed::from_raw(a.raw / b); }
+	inline bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+	inline bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+	inline bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+	inline bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+	inline bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+	inline bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+
+	// coordinates of collidables. double is what fangames use, so it stays the default;
+	// building with IWEMU_FIXED switches the scene to Fixed
+#ifdef IWEMU_FIXED
+	typedef Fixed Scalar;
+#else
+	typedef double Scalar;
+#endif
+
+	// the pixel a coordinate is in. halves are rounded away from zero, like lround
+	inline long pixel(double v) { return lround(v); }
+	inline long pixel(Fixed v)
+	{
+		const int64_t half = Fixed::ONE / 2;
+		return (long)(v.raw >= 0 ? (v.raw + half) >> Fixed::FRAC_BITS : -((half - v.raw) >> Fixed::FRAC_BITS));
+	}
+
+	// whole pixels at or below, and at or above a coordinate
+	inline long floor_pixel(double v) { return (long)floor(v); }
+	inline long floor_pixel(Fixed v) { return (long)(v.raw >> Fixed::FRAC_BITS); }
+	inline long ceil_pixel(double v) { return (long)ceil(v); }
+	inline long ceil_pixel(Fixed v) { return (long)-((-v.raw) >> Fixed::FRAC_BITS); }
+
+	// a distance rounded to whole pixels
+	inline double round_pixel(double v) { return round(v); }
+	inline Fixed round_pixel(Fixed v) { return Fixed::from_raw((int64_t)pixel(v) * Fixed::ONE); }
+
+	// what projections return when nothing is in the way
+	template <typename T> T infinity();
+	template <> inline double infinity<double>() { return INFINITY; }
+	// far enough that adding a room to it doesn't overflow
+	template <> inline Fixed infinity<Fixed>() { return Fixed::from_raw(INT64_MAX / 4); }
+}
@@ -0,0 +1,382 @@
+#include "grid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdlib.h>
+#include "bits.h"
+
+namespace iwemu
+{
+	// if the room is too big for the grid, cells get bigger
+	static const size_t MAX_CELLS = 1 << 22;
+
+	// grids of every thread take generations from here
+	static std::atomic<uint64_t> next_generation(1);
+
+	// objects of zero size still have to land in some cell, since they can be projected on
+	inline unsigned int at_least_one(unsigned int l)
+	{
+		return l ? l : 1;
+	}
+
+	// the box that segment takes in the grid
+	inline Hitbox seg_box(const Segment& seg)
+	{
+		if (seg.vertical)
+			return { seg.x, seg.y, 1, seg.length, seg.dx, seg.dy };
+		else
+			return { seg.x, seg.y, seg.length, 1, seg.dx, seg.dy };
+	}
+
+	inline bool inside(const Hitbox& inner, const Hitbox& outer)
+	{
+		return
+			inner.x >= outer.x && inner.y >= outer.y &&
+			right(inner) <= right(outer) && bottom(inner) <= bottom(outer);
+	}
+
+	// packs indices of static objects cell after cell
+	template <typename T>
+	static void build_static(const SolidGrid& grid, const T* objects, size_t objectsC,
+		std::vector<unsigned int>& offsets, std::vector<unsigned int>& indices)
+	{
+		size_t cellsC = (size_t)grid.cols() * grid.rows();
+		offsets.assign(cellsC + 1, 0);
+		for (int pass = 0; pass < 2; pass++)
+		{	// first pass counts, second one fills
+			for (size_t i = 0; i < objectsC; i++)
+			{
+				if (moving(objects[i])) continue;
+				SolidGrid::CellRange r = grid.range(objects[i]);
+				for (int row = r.row1; row <= r.row2; row++)
+				{
+					for (int col = r.col1; col <= r.col2; col++)
+					{
+						size_t c = (size_t)row * grid.cols() + col;
+						if (pass == 0)
+							offsets[c + 1]++;
+						else
+							indices[offsets[c]++] = (unsigned int)i;
+					}
+				}
+			}
+			if (pass == 0)
+			{
+				for (size_t c = 0; c < cellsC; c++)
+					offsets[c + 1] += offsets[c];
+				indices.resize(offsets[cellsC]);
+			}
+			else
+			{	// filling moved every offset onto the start of the next cell
+				for (size_t c = cellsC; c > 0; c--)
+					offsets[c] = offsets[c - 1];
+				offsets[0] = 0;
+			}
+		}
+	}
+
+	SolidGrid::SolidGrid(int cell_size) : _cell_size(cell_size)
+	{
+		this->_static = this->empty_index();
+		this->new_generation();
+		this->_moving_solids.resize(1);
+		this->_moving_segments.resize(1);
+	}
+
+	std::shared_ptr<const SolidGrid::StaticIndex> SolidGrid::empty_index() const
+	{
+		std::shared_ptr<StaticIndex> index = std::make_shared<StaticIndex>();
+		index->solid_offsets.assign(2, 0);
+		index->segment_offsets.assign(2, 0);
+		index->merged_solids.offsets.assign(1, 0);
+		index->merged_segments.offsets.assign(1, 0);
+		this->set_arrays(*index);
+		index->arrays.cols = index->arrays.rows = 1;
+		return index;
+	}
+
+	void SolidGrid::new_generation()
+	{
+		this->_generation = next_generation.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void SolidGrid::build(Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC)
+	{
+		// find out the size of the room
+		bool empty = true;
+		int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+		for (size_t i = 0; i < solidsC + segmentsC; i++)
+		{
+			const Hitbox s = i < solidsC ? solids[i] : seg_box(segments[i - solidsC]);
+			int sx2 = s.x + (int)at_least_one(s.width), sy2 = s.y + (int)at_least_one(s.height);
+			if (empty || s.x < x1) x1 = s.x;
+			if (empty || s.y < y1) y1 = s.y;
+			if (empty || sx2 > x2) x2 = sx2;
+			if (empty || sy2 > y2) y2 = sy2;
+			empty = false;
+		}
+		this->build(solids, solidsC, segments, segmentsC, { x1, y1, (unsigned int)(x2 - x1), (unsigned int)(y2 - y1), 0, 0 });
+	}
+
+	void SolidGrid::build(Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC, const Hitbox& area)
+	{
+		int x2 = area.x + (int)at_least_one(area.width), y2 = area.y + (int)at_least_one(area.height);
+		// align the grid with the tiles, so blocks don't spill over into the next cell
+		this->_x = (int)floor_div(area.x, this->_cell_size) * this->_cell_size;
+		this->_y = (int)floor_div(area.y, this->_cell_size) * this->_cell_size;
+		for (;;)
+		{
+			this->_cols = (int)floor_div(x2 - 1 - this->_x, this->_cell_size) + 1;
+			this->_rows = (int)floor_div(y2 - 1 - this->_y, this->_cell_size) + 1;
+			if ((size_t)this->_cols * this->_rows <= MAX_CELLS) break;
+			this->_cell_size *= 2;
+		}
+
+		std::shared_ptr<StaticIndex> index = std::make_shared<StaticIndex>();
+		merge_solids(solids, solidsC, index->merged_solids);
+		merge_segments(segments, segmentsC, index->merged_segments);
+		const MergedSolidsData& ms = index->merged_solids;
+		const MergedSegmentsData& mg = index->merged_segments;
+		build_static(*this, ms.boxes.data(), ms.boxes.size(), index->solid_offsets, index->solids);
+		size_t packedC = index->solids.size();
+		index->solid_x.resize(packedC);
+		index->solid_y.resize(packedC);
+		index->solid_right.resize(packedC);
+		index->solid_bottom.resize(packedC);
+		for (size_t k = 0; k < packedC; k++)
+		{
+			const Hitbox& s = ms.boxes[index->solids[k]];
+			index->solid_x[k] = s.x;
+			index->solid_y[k] = s.y;
+			index->solid_right[k] = s.x + (int)s.width;
+			index->solid_bottom[k] = s.y + (int)s.height;
+		}
+		build_static(*this, mg.segments.data(), mg.segments.size(), index->segment_offsets, index->segments);
+		this->set_arrays(*index);
+		this->_static = index;
+		this->_blocks.clear();
+		this->new_generation();
+		this->build_moving(solids, solidsC, segments, segmentsC);
+	}
+
+	void SolidGrid::build(const SolidGrid& shared, Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC)
+	{
+		this->_cell_size = shared._cell_size;
+		this->_x = shared._x;
+		this->_y = shared._y;
+		this->_cols = shared._cols;
+		this->_rows = shared._rows;
+		this->_static = shared._static;
+		this->_generation = shared._generation;
+		this->_blocks = shared._blocks;
+		this->_block_cells = shared._block_cells;
+		this->_block_cols = shared._block_cols;
+		this->build_moving(solids, solidsC, segments, segmentsC);
+	}
+
+	void SolidGrid::build(const StaticArrays& arrays, std::shared_ptr<const void> owner,
+		Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC)
+	{
+		std::shared_ptr<StaticIndex> index = std::make_shared<StaticIndex>();
+		index->arrays = arrays;
+		index->owner = owner;
+		this->_cell_size = arrays.cell_size;
+		this->_x = arrays.x;
+		this->_y = arrays.y;
+		this->_cols = arrays.cols;
+		this->_rows = arrays.rows;
+		this->_static = index;
+		this->_blocks.clear();
+		this->new_generation();
+		this->build_moving(solids, solidsC, segments, segmentsC);
+	}
+
+	void SolidGrid::build(int x, int y, int block_cells, int block_cols, int block_rows,
+		Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC)
+	{
+		this->_x = x;
+		this->_y = y;
+		this->_cols = block_cols * block_cells;
+		this->_rows = block_rows * block_cells;
+		this->_static = this->empty_index();
+		this->_blocks.assign((size_t)block_cols * block_rows, Block());
+		this->_block_cells = block_cells;
+		this->_block_cols = block_cols;
+		this->new_generation();
+		this->build_moving(solids, solidsC, segments, segmentsC);
+	}
+
+	void SolidGrid::set_block(int col, int row, const StaticArrays* arrays, std::shared_ptr<const void> owner,
+		Hitbox* solids, Segment* segments)
+	{
+		Block& block = this->_blocks[(size_t)row * this->_block_cols + col];
+		block = Block();
+		if (arrays)
+		{
+			block.arrays = *arrays;
+			block.solids = solids;
+			block.segments = segments;
+			block.owner = owner;
+		}
+		// snapshots of the scene tell the blocks it had by this
+		this->new_generation();
+	}
+
+	void SolidGrid::set_arrays(StaticIndex& index) const
+	{
+		index.arrays = {
+			this->_cell_size, this->_x, this->_y, this->_cols, this->_rows,
+			index.merged_solids.arrays(), index.merged_segments.arrays(),
+			index.solid_offsets.data(), index.solids.data(),
+			index.solid_x.data(), index.solid_y.data(), index.solid_right.data(), index.solid_bottom.data(),
+			index.segment_offsets.data(), index.segments.data()
+		};
+	}
+
+	void SolidGrid::build_moving(Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC)
+	{
+		this->_solids = solids;
+		this->_segments = segments;
+		size_t cellsC = (size_t)this->_cols * this->_rows;
+		this->_moving_solids.assign(cellsC, std::vector<unsigned int>());
+		this->_moving_segments.assign(cellsC, std::vector<unsigned int>());
+		this->_fat_solids.assign(solidsC, Hitbox());
+		this->_fat_segments.assign(segmentsC, Hitbox());
+		for (size_t i = 0; i < solidsC; i++)
+		{
+			const Hitbox& s = solids[i];
+			if (!moving(s)) continue;
+			this->_fat_solids[i] = this->fat_box(s.x, s.y, s.width, s.height, s.dx, s.dy);
+			this->insert(this->_moving_solids, (unsigned int)i, this->range(this->_fat_solids[i]));
+		}
+		for (size_t i = 0; i < segmentsC; i++)
+		{
+			if (!moving(segments[i])) continue;
+			Hitbox s = seg_box(segments[i]);
+			this->_fat_segments[i] = this->fat_box(s.x, s.y, s.width, s.height, s.dx, s.dy);
+			this->insert(this->_moving_segments, (unsigned int)i, this->range(this->_fat_segments[i]));
+		}
+	}
+
+	void SolidGrid::move_solid(unsigned int i, const Hitbox& to)
+	{
+		this->move(this->_moving_solids, this->_fat_solids[i], i, to, to.dx, to.dy);
+	}
+
+	void SolidGrid::move_segment(unsigned int i, const Segment& to)
+	{
+		this->move(this->_moving_segments, this->_fat_segments[i], i, seg_box(to), to.dx, to.dy);
+	}
+
+	void SolidGrid::move(std::vector<std::vector<unsigned int>>& cells, Hitbox& fat, unsigned int i, const Hitbox& to, int dx, int dy)
+	{
+		if (inside(to, fat))
+			return;	// still inside its fat box, cells are the same
+		Hitbox new_fat = this->fat_box(to.x, to.y, to.width, to.height, dx, dy);
+		CellRange r1 = this->range(fat), r2 = this->range(new_fat);
+		fat = new_fat;
+		if (r1.col1 == r2.col1 && r1.row1 == r2.row1 && r1.col2 == r2.col2 && r1.row2 == r2.row2)
+			return;
+		this->remove(cells, i, r1);
+		this->insert(cells, i, r2);
+	}
+
+	Hitbox SolidGrid::fat_box(int x, int y, unsigned int width, unsigned int height, int dx, int dy) const
+	{
+		// enough room for a few frames of movement
+		int margin = this->_cell_size / 4 + 2 * std::max(abs(dx), abs(dy));
+		return {
+			x - margin, y - margin,
+			at_least_one(width) + 2 * margin, at_least_one(height) + 2 * margin,
+			dx, dy
+		};
+	}
+
+	int SolidGrid::col_of(int x) const
+	{
+		return std::min(std::max((int)floor_div(x - this->_x, this->_cell_size), 0), this->_cols - 1);
+	}
+
+	int SolidGrid::row_of(int y) const
+	{
+		return std::min(std::max((int)floor_div(y - this->_y, this->_cell_size), 0), this->_rows - 1);
+	}
+
+	SolidGrid::CellRange SolidGrid::range(int x, int y, unsigned int width, unsigned int height) const
+	{
+		return {
+			this->col_of(x), this->row_of(y),
+			this->col_of(x + (int)at_least_one(width) - 1), this->row_of(y + (int)at_least_one(height) - 1)
+		};
+	}
+
+	SolidGrid::CellRange SolidGrid::range(const Hitbox& hbox) const
+	{
+		return this->range(hbox.x, hbox.y, hbox.width, hbox.height);
+	}
+
+	SolidGrid::CellRange SolidGrid::range(const Segment& seg) const
+	{
+		return this->range(seg_box(seg));
+	}
+
+	// cell c of a static index, with parts into solids and segments
+	static SolidGrid::Cell cell_of(const SolidGrid::StaticArrays& index, size_t c, Hitbox* solids, Segment* segments)
+	{
+		unsigned int s1 = index.solid_offsets[c], s2 = index.solid_offsets[c + 1];
+		unsigned int g1 = index.segment_offsets[c], g2 = index.segment_offsets[c + 1];
+		return {
+			index.solids + s1, s2 - s1,
+			index.segments + g1, g2 - g1,
+			{ index.solid_x + s1, index.solid_y + s1, index.solid_right + s1, index.solid_bottom + s1 },
+			&index.merged_solids, &index.merged_segments,
+			solids, segments
+		};
+	}
+
+	SolidGrid::Cell SolidGrid::static_cell(int col, int row) const
+	{
+		if (this->_blocks.empty())
+			return cell_of(this->_static->arrays, this->cell_index(col, row), this->_solids, this->_segments);
+		int n = this->_block_cells;
+		const Block& block = this->_blocks[(size_t)(row / n) * this->_block_cols + col / n];
+		if (!block.arrays.solid_offsets)
+			return cell_of(this->_static->arrays, 0, this->_solids, this->_segments);
+		return cell_of(block.arrays, (size_t)(row % n) * n + col % n, block.solids, block.segments);
+	}
+
+	SolidGrid::Cell SolidGrid::moving_cell(int col, int row) const
+	{
+		size_t c = this->cell_index(col, row);
+		const std::vector<unsigned int>& s = this->_moving_solids[c];
+		const std::vector<unsigned int>& g = this->_moving_segments[c];
+		return { s.data(), s.size(), g.data(), g.size(), { 0, 0, 0, 0 }, 0, 0, this->_solids, this->_segments };
+	}
+
+	void SolidGrid::insert(std::vector<std::vector<unsigned int>>& cells, unsigned int i, const CellRange& r)
+	{
+		for (int row = r.row1; row <= r.row2; row++)
+			for (int col = r.col1; col <= r.col2; col++)
+				cells[this->cell_index(col, row)].push_back(i);
+	}
+
+	void SolidGrid::remove(std::vector<std::vector<unsigned int>>& cells, unsigned int i, const CellRange& r)
+	{
+		for (int row = r.row1; row <= r.row2; row++)
+		{
+			for (int col = r.col1; col <= r.col2; col++)
+			{
+				std::vector<unsigned int>& v = cells[this->cell_index(col, row)];
+				for (size_t k = 0; k < v.size(); k++)
+				{
+					if (v[k] == i)
+					{	// order in a cell doesn't matter
+						v[k] = v.back();
+						v.pop_back();
+						break;
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "hitbox.h"
+#include "kernels.h"
+#include "merge.h"
+
+namespace iwemu
+{
+	// things that have a speed are moving, everything else stays where it is forever
+	inline bool moving(const Hitbox& hbox) { return hbox.dx != 0 || hbox.dy != 0; }
+	inline bool moving(const Segment& seg) { return seg.dx != 0 || seg.dy != 0; }
+
+	// uniform grid of buckets over the room. every solid and segment is put
+	// in every cell its box touches, so a query only has to look into the cells
+	// its own box touches. things outside of the grid are clamped to the border cells.
+	// grid only stores indices, the actual objects stay in the arrays of the scene.
+	//
+	// static objects are merged (merge.h) and packed into one array once, cell after cell.
+	// that part never changes, so grids of scenes with the same static objects can share it.
+	// a grid can also be made of square blocks of cells with a static part each, that are put in
+	// and taken out on their own: the chunks of a world (world.h), indexed when they were written.
+	// moving objects are kept in a box a bit bigger than them (fat box),
+	// and only change cells when they leave it
+	class SolidGrid
+	{
+	public:
+		// fangame rooms are made of 32x32 blocks
+		static const int DEFAULT_CELL_SIZE = 32;
+
+		struct Cell
+		{
+			const unsigned int* solids;
+			size_t solidsC;
+			const unsigned int* segments;
+			size_t segmentsC;
+			// borders of the solids, in the same order. only static cells have them, x is 0 in moving ones
+			BoxArrays boxes;
+			// indices of static cells are into merged objects, and these are 0 in moving cells,
+			// whose indices are into the arrays of the scene
+			const MergedSolids* merged_solids;
+			const MergedSegments* merged_segments;
+			// what indices of a moving cell, and parts of merged objects of a static one, are into:
+			// arrays of the scene, or of a chunk of a world for a cell of a block
+			Hitbox* solid_array;
+			Segment* segment_array;
+		};
+
+		// the part of a grid that never changes, as plain arrays, so it can be written to a file
+		// and used from it as it is (level.h). arrays by cell have cols * rows + 1 offsets
+		struct StaticArrays
+		{
+			int cell_size, x, y, cols, rows;
+			MergedSolids merged_solids;
+			MergedSegments merged_segments;
+			// indices of merged solids in cell c are solids[solid_offsets[c]] ... solids[solid_offsets[c + 1] - 1]
+			const unsigned int* solid_offsets;
+			const unsigned int* solids;
+			// borders of those solids, in the same order
+			const int* solid_x;
+			const int* solid_y;
+			const int* solid_right;
+			const int* solid_bottom;
+			const unsigned int* segment_offsets;
+			const unsigned int* segments;
+
+			size_t cells() const { return (size_t)this->cols * this->rows; }
+		};
+
+		// inclusive range of cells
+		struct CellRange
+		{
+			int col1, row1, col2, row2;
+		};
+
+		SolidGrid(int cell_size = DEFAULT_CELL_SIZE);
+
+		// (re)builds the grid, so it covers all of the objects
+		void build(Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC);
+		// same, but cells cover area, and whatever is out of it is clamped to the border cells
+		void build(Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC, const Hitbox& area);
+		// same, but cells and static objects are taken from shared, which has to be built
+		// from the same static objects. only moving ones are indexed
+		void build(const SolidGrid& shared, Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC);
+		// same, but the static part is arrays that stay where they are. owner is kept for as long as
+		// the arrays are used
+		void build(const StaticArrays& arrays, std::shared_ptr<const void> owner,
+			Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC);
+		// same, but cells are block_cols x block_rows squares of block_cells x block_cells cells from (x, y),
+		// and the static part of each square is set on its own by set_block() (the chunks of a world).
+		// every block is empty at first. only moving objects are indexed here
+		void build(int x, int y, int block_cells, int block_cols, int block_rows,
+			Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC);
+		// makes the static part of a block the one of arrays, which has to have the cells of the block.
+		// parts of merged objects are into solids and segments, and owner is kept while the block has them.
+		// 0 arrays empties the block. the generation is a new one after it
+		void set_block(int col, int row, const StaticArrays* arrays, std::shared_ptr<const void> owner,
+			Hitbox* solids, Segment* segments);
+
+		// has to be called every time a moving object changes its position
+		void move_solid(unsigned int i, const Hitbox& to);
+		void move_segment(unsigned int i, const Segment& to);
+
+		CellRange range(int x, int y, unsigned int width, unsigned int height) const;
+		CellRange range(const Hitbox& hbox) const;
+		CellRange range(const Segment& seg) const;
+
+		Cell static_cell(int col, int row) const;
+		Cell moving_cell(int col, int row) const;
+		// number of the static part: grids sharing it have the same one, and every other build()
+		// or set_block() gives one that no grid had before
+		uint64_t generation() const { return this->_generation; }
+		const StaticArrays& static_arrays() const { return this->_static->arrays; }
+		int cell_size() const { return this->_cell_size; }
+		int cols() const { return this->_cols; }
+		int rows() const { return this->_rows; }
+		// world coordinate of the left/top border of a column/row
+		int col_x(int col) const { return this->_x + col * this->_cell_size; }
+		int row_y(int row) const { return this->_y + row * this->_cell_size; }
+		int col_of(int x) const;
+		int row_of(int y) const;
+
+	private:
+		int _cell_size;
+		int _x = 0, _y = 0;
+		int _cols = 1, _rows = 1;
+		// arrays the moving cells, and static ones of a grid that isn't made of blocks, are into
+		Hitbox* _solids = 0;
+		Segment* _segments = 0;
+
+		// merged static objects. arrays point into the vectors below when the index is built here,
+		// or into whatever owner keeps when it's not
+		struct StaticIndex
+		{
+			StaticArrays arrays;
+			MergedSolidsData merged_solids;
+			MergedSegmentsData merged_segments;
+			std::vector<unsigned int> solid_offsets;
+			std::vector<unsigned int> solids;
+			// copy of the boxes of the solids above, as arrays of borders
+			std::vector<int> solid_x, solid_y, solid_right, solid_bottom;
+			std::vector<unsigned int> segment_offsets;
+			std::vector<unsigned int> segments;
+			std::shared_ptr<const void> owner;
+		};
+		std::shared_ptr<const StaticIndex> _static;
+		uint64_t _generation = 0;
+
+		// a square of cells with a static part of its own
+		struct Block
+		{
+			// there is nothing in it if arrays.solid_offsets is 0
+			StaticArrays arrays;
+			Hitbox* solids;
+			Segment* segments;
+			std::shared_ptr<const void> owner;
+		};
+		// blocks row after row, none if the static part is _static
+		std::vector<Block> _blocks;
+		int _block_cells = 0, _block_cols = 0;
+
+		// moving objects
+		std::vector<std::vector<unsigned int>> _moving_solids;
+		std::vector<std::vector<unsigned int>> _moving_segments;
+		// fat boxes of moving objects, by index in the scene (unused for static ones)
+		std::vector<Hitbox> _fat_solids;
+		std::vector<Hitbox> _fat_segments;
+
+		size_t cell_index(int col, int row) const { return (size_t)row * this->_cols + col; }
+		void build_moving(Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC);
+		// points the arrays of index at its vectors
+		void set_arrays(StaticIndex& index) const;
+		// an index of one cell with nothing in it, for a grid with nothing static yet or made of blocks
+		std::shared_ptr<const StaticIndex> empty_index() const;
+		void new_generation();
+		Hitbox fat_box(int x, int y, unsigned int width, unsigned int height, int dx, int dy) const;
+		void move(std::vector<std::vector<unsigned int>>& cells, Hitbox& fat, unsigned int i, const Hitbox& to, int dx, int dy);
+		void insert(std::vector<std::vector<unsigned int>>& cells, unsigned int i, const CellRange& r);
+		void remove(std::vector<std::vector<unsigned int>>& cells, unsigned int i, const CellRange& r);
+	};
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "fixed.h"
+
+namespace iwemu
+{
+	// 64-bit hashing of plain values. same values give the same hash on every platform,
+	// doubles are hashed by their bits, so it tells apart anything that isn't bit-identical
+	const uint64_t HASH_SEED = 0xcbf29ce484222325ULL;
+
+	inline uint64_t hash_mix(uint64_t h, uint64_t v)
+	{
+		h ^= v;
+		h *= 0x9e3779b97f4a7c15ULL;
+		return h ^ (h >> 29);
+	}
+
+	inline uint64_t hash_mix(uint64_t h, double v)
+	{
+		uint64_t bits;
+		memcpy(&bits, &v, sizeof(bits));
+		return hash_mix(h, bits);
+	}
+
+	inline uint64_t hash_mix(uint64_t h, Fixed v)
+	{
+		return hash_mix(h, (uint64_t)v.raw);
+	}
+
+	inline uint64_t hash_mix(uint64_t h, int a, int b)
+	{
+		return hash_mix(h, ((uint64_t)(uint32_t)a << 32) | (uint32_t)b);
+	}
+}
@@ -4,21 +4,6 @@
 
 namespace iwemu
 {
-	inline int left(const Hitbox& hbox) { return hbox.x; }
-	inline int top(const Hitbox& hbox) { return hbox.y; }
-	inline int right(const Hitbox& hbox) { return hbox.x + hbox.width; }
-	inline int bottom(const Hitbox& hbox) { return hbox.y + hbox.height; }
-
-	inline double left(const BBox& bbox) { return bbox.x; }
-	inline double top(const BBox& bbox) { return bbox.y; }
-	inline double right(const BBox& bbox) { return bbox.x + bbox.width; }
-	inline double bottom(const BBox& bbox) { return bbox.y + bbox.height; }
-
-	inline bool intersect(int s1, unsigned int l1, int s2, unsigned int l2)
-	{
-		return (s2 < s1 + (int)l1) && (s1 < s2 + (int)l2);
-	}
-
 	bool intersect(const Hitbox& hbox, const Segment& seg)
 	{
 		if (seg.vertical)
@@ -42,27 +27,32 @@ namespace iwemu
 			intersect(hbox1.y, hbox1.height, hbox2.y, hbox2.height);
 	}
 
-	inline void to_hitbox(const BBox& bbox, Hitbox& hbox_dest)
+	template <typename T>
+	void to_hitbox(const BasicBBox<T>& bbox, Hitbox& hbox_dest)
 	{
-		hbox_dest = { lround(bbox.x), lround(bbox.y), bbox.width, bbox.height, lround(bbox.dx), lround(bbox.dy) };
+		hbox_dest = { pixel(bbox.x), pixel(bbox.y), bbox.width, bbox.height, pixel(bbox.dx), pixel(bbox.dy) };
 	}
 
-	Hitbox get_hitbox(const BBox& bbox)
+	template <typename T>
+	Hitbox get_hitbox(const BasicBBox<T>& bbox)
 	{
-		return { lround(bbox.x), lround(bbox.y), bbox.width, bbox.height, lround(bbox.dx), lround(bbox.dy) };
+		return { pixel(bbox.x), pixel(bbox.y), bbox.width, bbox.height, pixel(bbox.dx), pixel(bbox.dy) };
 	}
 
-	inline void to_bbox(const Hitbox& hbox, BBox& bbox_dest)
+	template <typename T>
+	void to_bbox(const Hitbox& hbox, BasicBBox<T>& bbox_dest)
 	{
-		bbox_dest = { (double)hbox.x, (double)hbox.y, hbox.width, hbox.height, (double)hbox.dx, (double)hbox.dy };
+		bbox_dest = { T(hbox.x), T(hbox.y), hbox.width, hbox.height, T(hbox.dx), T(hbox.dy) };
 	}
 
-	BBox get_bbox(const Hitbox& hbox)
+	template <typename T>
+	BasicBBox<T> get_bbox(const Hitbox& hbox)
 	{
-		return { (double)hbox.x, (double)hbox.y, hbox.width, hbox.height, (double)hbox.dx, (double)hbox.dy };
+		return { T(hbox.x), T(hbox.y), hbox.width, hbox.height, T(hbox.dx), T(hbox.dy) };
 	}
 
-	BBox rel(const BBox& bbox, double dx, double dy)
+	template <typename T>
+	BasicBBox<T> rel(const BasicBBox<T>& bbox, typename NoDeduce<T>::type dx, typename NoDeduce<T>::type dy)
 	{
 		return { bbox.x + dx, bbox.y + dy, bbox.width, bbox.height, bbox.dx, bbox.dy };
 	}
@@ -77,111 +67,139 @@ namespace iwemu
 		return { seg.x + dx, seg.y + dy, seg.length, seg.vertical, seg.block_lt, seg.block_rb, seg.dx, seg.dy };
 	}
 
-	double project_left(const BBox& bbox, const Hitbox& hbox)
+	template <typename T>
+	T project_left(const BasicBBox<T>& bbox, const Hitbox& hbox)
 	{
-		if (intersect(lround(bbox.y), bbox.height, hbox.y, hbox.height))
+		if (intersect(pixel(bbox.y), bbox.height, hbox.y, hbox.height))
 		{	// projections on Y axis intersect
-			if (intersect(lround(bbox.x), bbox.width, hbox.x, hbox.width))
-				return 0.0;	// boxes intersect
+			if (intersect(pixel(bbox.x), bbox.width, hbox.x, hbox.width))
+				return T(0);	// boxes intersect
 
 			if (hbox.x < bbox.x)	// if to the left
 				return left(bbox) - right(hbox);
 			else
-				return INFINITY;
+				return infinity<T>();
 		}
-		return INFINITY;
+		return infinity<T>();
 	}
 
-	double project_left(const BBox& bbox, const Segment& seg)
+	template <typename T>
+	T project_left(const BasicBBox<T>& bbox, const Segment& seg)
 	{
 		if (seg.vertical &&			// vertical
 			seg.block_rb &&		// and blocks from right
-			seg.x <= lround(left(bbox)) &&	// and to the left
-			intersect(lround(bbox.y), bbox.height, seg.y, seg.length))
+			seg.x <= pixel(left(bbox)) &&	// and to the left
+			intersect(pixel(bbox.y), bbox.height, seg.y, seg.length))
 		{	// and projections on Y axis intersect
 			return left(bbox) - seg.x;
 		}
-		return INFINITY;
+		return infinity<T>();
 	}
 
-	double project_up(const BBox& bbox, const Hitbox& hbox)
+	template <typename T>
+	T project_up(const BasicBBox<T>& bbox, const Hitbox& hbox)
 	{
-		if (intersect(lround(bbox.x), bbox.width, hbox.x, hbox.width))
+		if (intersect(pixel(bbox.x), bbox.width, hbox.x, hbox.width))
 		{	// projections on X axis intersect
-			if (intersect(lround(bbox.y), bbox.height, hbox.y, hbox.height))
-				return 0.0; // boxes intersect
+			if (intersect(pixel(bbox.y), bbox.height, hbox.y, hbox.height))
+				return T(0); // boxes intersect
 
 			if (hbox.y < bbox.y)	// if to the up
 				return top(bbox) - bottom(hbox);
 			else
-				return INFINITY;
+				return infinity<T>();
 		}
-		return INFINITY;
+		return infinity<T>();
 	}
 
-	double project_up(const BBox& bbox, const Segment& seg)
+	template <typename T>
+	T project_up(const BasicBBox<T>& bbox, const Segment& seg)
 	{
 		if (!seg.vertical &&		// horizontal
 			seg.block_rb &&		// and blocks from bottom
-			seg.y <= lround(top(bbox)) &&	// and to the up
-			intersect(lround(bbox.x), bbox.width, seg.x, seg.length))
+			seg.y <= pixel(top(bbox)) &&	// and to the up
+			intersect(pixel(bbox.x), bbox.width, seg.x, seg.length))
 		{	// and projections on X axis intersect
 			return top(bbox) - seg.y;
 		}
-		return INFINITY;
+		return infinity<T>();
 	}
 
-	double project_right(const BBox& bbox, const Hitbox& hbox)
+	template <typename T>
+	T project_right(const BasicBBox<T>& bbox, const Hitbox& hbox)
 	{
-		if (intersect(lround(bbox.y), bbox.height, hbox.y, hbox.height))
+		if (intersect(pixel(bbox.y), bbox.height, hbox.y, hbox.height))
 		{	// projections on Y axis intersect
-			if (intersect(lround(bbox.x), bbox.width, hbox.x, hbox.width))
-				return 0.0;	// boxes intersect
+			if (intersect(pixel(bbox.x), bbox.width, hbox.x, hbox.width))
+				return T(0);	// boxes intersect
 
 			if (hbox.x > bbox.x)	// if to the right
 				return left(hbox) - right(bbox);
 			else
-				return INFINITY;
+				return infinity<T>();
 		}
-		return INFINITY;
+		return infinity<T>();
 	}
 
-	double project_right(const BBox& bbox, const Segment& seg)
+	template <typename T>
+	T project_right(const BasicBBox<T>& bbox, const Segment& seg)
 	{
 		if (seg.vertical &&			// vertical
 			seg.block_lt &&		// and blocks from left
-			seg.x >= lround(right(bbox)) &&	// and to the right
-			intersect(lround(bbox.y), bbox.height, seg.y, seg.length))
+			seg.x >= pixel(right(bbox)) &&	// and to the right
+			intersect(pixel(bbox.y), bbox.height, seg.y, seg.length))
 		{	// and projections on Y axis intersect
 			return seg.x - right(bbox);
 		}
-		return INFINITY;
+		return infinity<T>();
 	}
 
-	double project_down(const BBox& bbox, const Hitbox& hbox)
+	template <typename T>
+	T project_down(const BasicBBox<T>& bbox, const Hitbox& hbox)
 	{
-		if (intersect(lround(bbox.x), bbox.width, hbox.x, hbox.width))
+		if (intersect(pixel(bbox.x), bbox.width, hbox.x, hbox.width))
 		{	// projections on X axis intersect
-			if (intersect(lround(bbox.y), bbox.height, hbox.y, hbox.height))
-				return 0.0; // boxes intersect
+			if (intersect(pixel(bbox.y), bbox.height, hbox.y, hbox.height))
+				return T(0); // boxes intersect
 
 			if (hbox.y > bbox.y)	// if to the down
 				return top(hbox) - bottom(bbox);
 			else
-				return INFINITY;
+				return infinity<T>();
 		}
-		return INFINITY;
+		return infinity<T>();
 	}
 
-	double project_down(const BBox& bbox, const Segment& seg)
+	template <typename T>
+	T project_down(const BasicBBox<T>& bbox, const Segment& seg)
 	{
 		if (!seg.vertical &&			// horizontal
 			seg.block_lt &&				// and blocks from top
-			seg.y >= lround(bottom(bbox)) &&	// and to the down
-			intersect(lround(bbox.x), bbox.width, seg.x, seg.length))
+			seg.y >= pixel(bottom(bbox)) &&	// and to the down
+			intersect(pixel(bbox.x), bbox.width, seg.x, seg.length))
 		{	// and projections on X axis intersect
 			return seg.y - bottom(bbox);
 		}
-		return INFINITY;
-	}
-}
\ No newline at end of file
+		return infinity<T>();
+	}
+
+	// everything on BasicBBox, for both kinds of coordinates
+#define IWEMU_BBOX_FUNCTIONS(T) \
+	template void to_hitbox(const BasicBBox<T>&, Hitbox&); \
+	template Hitbox get_hitbox(const BasicBBox<T>&); \
+	template void to_bbox(const Hitbox&, BasicBBox<T>&); \
+	template BasicBBox<T> get_bbox(const Hitbox&); \
+	template BasicBBox<T> rel(const BasicBBox<T>&, T, T); \
+	template T project_left(const BasicBBox<T>&, const Hitbox&); \
+	template T project_left(const BasicBBox<T>&, const Segment&); \
+	template T project_up(const BasicBBox<T>&, const Hitbox&); \
+	template T project_up(const BasicBBox<T>&, const Segment&); \
+	template T project_right(const BasicBBox<T>&, const Hitbox&); \
+	template T project_right(const BasicBBox<T>&, const Segment&); \
+	template T project_down(const BasicBBox<T>&, const Hitbox&); \
+	template T project_down(const BasicBBox<T>&, const Segment&);
+
+	IWEMU_BBOX_FUNCTIONS(double)
+	IWEMU_BBOX_FUNCTIONS(Fixed)
+#undef IWEMU_BBOX_FUNCTIONS
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stddef.h>
+#include "fixed.h"
+
 
 namespace iwemu
 {
@@ -22,46 +25,58 @@ namespace iwemu
 		int dx, dy;
 	};
 
-	struct BBox
+	// box of a collidable, on subpixel coordinates of type T
+	template <typename T>
+	struct BasicBBox
 	{
-		double x, y;
+		T x, y;
 		unsigned int width, height;
-		double dx, dy;
+		T dx, dy;
 	};
+	typedef BasicBBox<Scalar> BBox;
+
+	// T of an argument that shouldn't take part in deduction, so rel(bbox, 0, 1) works
+	template <typename T>
+	struct NoDeduce { typedef T type; };
 
-	inline int left(const Hitbox& hbox);
-	inline int top(const Hitbox& hbox);
-	inline int right(const Hitbox& hbox);
-	inline int bottom(const Hitbox& hbox);
+	// inline helpers are defined here, so other translation units can use them
+	inline int left(const Hitbox& hbox) { return hbox.x; }
+	inline int top(const Hitbox& hbox) { return hbox.y; }
+	inline int right(const Hitbox& hbox) { return hbox.x + hbox.width; }
+	inline int bottom(const Hitbox& hbox) { return hbox.y + hbox.height; }
 
-	inline double left(const BBox& bbox);
-	inline double top(const BBox& bbox);
-	inline double right(const BBox& bbox);
-	inline double bottom(const BBox& bbox);
+	template <typename T> inline T left(const BasicBBox<T>& bbox) { return bbox.x; }
+	template <typename T> inline T top(const BasicBBox<T>& bbox) { return bbox.y; }
+	template <typename T> inline T right(const BasicBBox<T>& bbox) { return bbox.x + bbox.width; }
+	template <typename T> inline T bottom(const BasicBBox<T>& bbox) { return bbox.y + bbox.height; }
 
-	inline bool intersect(int s1, unsigned int l1, int s2, unsigned int l2);
+	inline bool intersect(int s1, unsigned int l1, int s2, unsigned int l2)
+	{
+		return (s2 < s1 + (int)l1) && (s1 < s2 + (int)l2);
+	}
 
 	bool intersect(const Hitbox& hbox, const Segment& seg);
 
 	bool intersect(const Hitbox& hbox1, const Hitbox& hbox2);
 
-	inline void to_hitbox(const BBox& bbox, Hitbox& hbox_dest);
-	Hitbox get_hitbox(const BBox& bbox);
+	// functions on BasicBBox are defined in hitbox.cpp for double and Fixed
+	template <typename T> void to_hitbox(const BasicBBox<T>& bbox, Hitbox& hbox_dest);
+	template <typename T> Hitbox get_hitbox(const BasicBBox<T>& bbox);
 
-	inline void to_bbox(const Hitbox& hbox, BBox& bbox_dest);
-	BBox get_bbox(const Hitbox& hbox);
+	template <typename T = Scalar> void to_bbox(const Hitbox& hbox, BasicBBox<T>& bbox_dest);
+	template <typename T = Scalar> BasicBBox<T> get_bbox(const Hitbox& hbox);
 
-	BBox rel(const BBox& bbox, double dx, double dy);
+	template <typename T> BasicBBox<T> rel(const BasicBBox<T>& bbox, typename NoDeduce<T>::type dx, typename NoDeduce<T>::type dy);
 	Hitbox rel(const Hitbox& hbox, int dx, int dy);
 	Segment rel(const Segment& seg, int dx, int dy);
 
 	// how much bbox needs to be moved horizontaly until it hits the hbox
-	double project_left(const BBox& bbox, const Hitbox& hbox);
-	double project_left(const BBox& bbox, const Segment& seg);
-	double project_up(const BBox& bbox, const Hitbox& hbox);
-	double project_up(const BBox& bbox, const Segment& seg);
-	double project_right(const BBox& bbox, const Hitbox& hbox);
-	double project_right(const BBox& bbox, const Segment& seg);
-	double project_down(const BBox& bbox, const Hitbox& hbox);
-	double project_down(const BBox& bbox, const Segment& seg);
+	template <typename T> T project_left(const BasicBBox<T>& bbox, const Hitbox& hbox);
+	template <typename T> T project_left(const BasicBBox<T>& bbox, const Segment& seg);
+	template <typename T> T project_up(const BasicBBox<T>& bbox, const Hitbox& hbox);
+	template <typename T> T project_up(const BasicBBox<T>& bbox, const Segment& seg);
+	template <typename T> T project_right(const BasicBBox<T>& bbox, const Hitbox& hbox);
+	template <typename T> T project_right(const BasicBBox<T>& bbox, const Segment& seg);
+	template <typename T> T project_down(const BasicBBox<T>& bbox, const Hitbox& hbox);
+	template <typename T> T project_down(const BasicBBox<T>& bbox, const Segment& seg);
 }
@@ -0,0 +1,264 @@
+#include "kernels.h"
+
+#include <atomic>
+#include "bits.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define IWEMU_HAS_AVX2 1
+#define IWEMU_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define IWEMU_HAS_AVX2 1
+#define IWEMU_AVX2
+#else
+#define IWEMU_HAS_AVX2 0
+#endif
+
+namespace iwemu
+{
+	// the plain loops. they are the reference, simd ones have to give the same positions
+	static size_t first_intersect_scalar(const BoxArrays& b, size_t n, const Hitbox& q)
+	{
+		int qr = q.x + (int)q.width, qb = q.y + (int)q.height;
+		for (size_t k = 0; k < n; k++)
+		{
+			if (b.x[k] < qr && q.x < b.right[k] && b.y[k] < qb && q.y < b.bottom[k])
+				return k;
+		}
+		return NOT_FOUND;
+	}
+
+	// "along" is the axis of projection, "across" is the other one
+	template <Direction dir>
+	static NearestBoxes nearest_scalar(const BoxArrays& b, size_t n, const Hitbox& q, int limit)
+	{
+		const bool horizontal = dir == Direction::LEFT || dir == Direction::RIGHT;
+		const bool back = dir == Direction::LEFT || dir == Direction::UP;
+		const int* a1 = horizontal ? b.x : b.y;
+		const int* a2 = horizontal ? b.right : b.bottom;
+		const int* c1 = horizontal ? b.y : b.x;
+		const int* c2 = horizontal ? b.bottom : b.right;
+		// going back, the far border of a box is the near one
+		const int* value = back ? a2 : a1;
+		int qa = horizontal ? q.x : q.y, qa2 = qa + (int)(horizontal ? q.width : q.height);
+		int qc = horizontal ? q.y : q.x, qc2 = qc + (int)(horizontal ? q.height : q.width);
+
+		NearestBoxes r = { NOT_FOUND, NOT_FOUND };
+		int best = 0;
+		for (size_t k = 0; k < n; k++)
+		{
+			if (!(c1[k] < qc2 && qc < c2[k])) continue;
+			if (a1[k] < qa2 && qa < a2[k])
+			{
+				if (r.touching == NOT_FOUND) r.touching = k;
+				continue;
+			}
+			if (back ? a1[k] <= limit : a1[k] >= limit)
+			{
+				int v = value[k];
+				if (r.nearest == NOT_FOUND || (back ? v > best : v < best))
+				{
+					best = v;
+					r.nearest = k;
+				}
+			}
+		}
+		return r;
+	}
+
+#if IWEMU_HAS_AVX2
+	static bool has_avx2()
+	{
+#ifdef _MSC_VER
+		int r[4];
+		__cpuid(r, 0);
+		if (r[0] < 7) return false;
+		__cpuid(r, 1);
+		// avx registers have to be saved by the os as well
+		if (!(r[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) return false;
+		__cpuidex(r, 7, 0);
+		return (r[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+	static inline BoxArrays advance(const BoxArrays& b, size_t k)
+	{
+		return { b.x + k, b.y + k, b.right + k, b.bottom + k };
+	}
+
+	IWEMU_AVX2 static inline __m256i load(const int* p)
+	{
+		return _mm256_loadu_si256((const __m256i*)p);
+	}
+
+	IWEMU_AVX2 static inline int mask_of(__m256i v)
+	{
+		return _mm256_movemask_ps(_mm256_castsi256_ps(v));
+	}
+
+	IWEMU_AVX2 static size_t first_intersect_avx2(const BoxArrays& b, size_t n, const Hitbox& q)
+	{
+		__m256i qx = _mm256_set1_epi32(q.x), qy = _mm256_set1_epi32(q.y);
+		__m256i qr = _mm256_set1_epi32(q.x + (int)q.width), qb = _mm256_set1_epi32(q.y + (int)q.height);
+		size_t k = 0;
+		for (; k + 8 <= n; k += 8)
+		{
+			__m256i hit = _mm256_and_si256(
+				_mm256_and_si256(_mm256_cmpgt_epi32(qr, load(b.x + k)), _mm256_cmpgt_epi32(load(b.right + k), qx)),
+				_mm256_and_si256(_mm256_cmpgt_epi32(qb, load(b.y + k)), _mm256_cmpgt_epi32(load(b.bottom + k), qy)));
+			int m = mask_of(hit);
+			if (m) return k + low_bit((unsigned int)m);
+		}
+		size_t t = first_intersect_scalar(advance(b, k), n - k, q);
+		return t == NOT_FOUND ? NOT_FOUND : k + t;
+	}
+
+	// every lane keeps its own closest box and where it was, lanes are merged at the end
+	template <Direction dir>
+	IWEMU_AVX2 static NearestBoxes nearest_avx2(const BoxArrays& b, size_t n, const Hitbox& q, int limit)
+	{
+		const bool horizontal = dir == Direction::LEFT || dir == Direction::RIGHT;
+		const bool back = dir == Direction::LEFT || dir == Direction::UP;
+		const int* a1 = horizontal ? b.x : b.y;
+		const int* a2 = horizontal ? b.right : b.bottom;
+		const int* c1 = horizontal ? b.y : b.x;
+		const int* c2 = horizontal ? b.bottom : b.right;
+		const int* value = back ? a2 : a1;
+		int qa = horizontal ? q.x : q.y, qa2 = qa + (int)(horizontal ? q.width : q.height);
+		int qc = horizontal ? q.y : q.x, qc2 = qc + (int)(horizontal ? q.height : q.width);
+
+		__m256i vqa = _mm256_set1_epi32(qa), vqa2 = _mm256_set1_epi32(qa2);
+		__m256i vqc = _mm256_set1_epi32(qc), vqc2 = _mm256_set1_epi32(qc2);
+		__m256i vlimit = _mm256_set1_epi32(limit);
+		__m256i ones = _mm256_set1_epi32(-1);
+		__m256i pos = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), eight = _mm256_set1_epi32(8);
+		__m256i best = _mm256_setzero_si256(), best_pos = _mm256_setzero_si256(), found = _mm256_setzero_si256();
+		NearestBoxes r = { NOT_FOUND, NOT_FOUND };
+		size_t k = 0;
+		for (; k + 8 <= n; k += 8)
+		{
+			__m256i va1 = load(a1 + k);
+			__m256i across = _mm256_and_si256(_mm256_cmpgt_epi32(vqc2, load(c1 + k)), _mm256_cmpgt_epi32(load(c2 + k), vqc));
+			__m256i along = _mm256_and_si256(_mm256_cmpgt_epi32(vqa2, va1), _mm256_cmpgt_epi32(load(a2 + k), vqa));
+			if (r.touching == NOT_FOUND)
+			{
+				int m = mask_of(_mm256_and_si256(across, along));
+				if (m) r.touching = k + low_bit((unsigned int)m);
+			}
+			__m256i in_dir = back ?
+				_mm256_xor_si256(_mm256_cmpgt_epi32(va1, vlimit), ones) :
+				_mm256_xor_si256(_mm256_cmpgt_epi32(vlimit, va1), ones);
+			__m256i candidate = _mm256_andnot_si256(along, _mm256_and_si256(across, in_dir));
+			__m256i v = load(value + k);
+			__m256i better = back ? _mm256_cmpgt_epi32(v, best) : _mm256_cmpgt_epi32(best, v);
+			// the first candidate of a lane is taken whatever its value is
+			__m256i take = _mm256_and_si256(candidate, _mm256_or_si256(better, _mm256_xor_si256(found, ones)));
+			best = _mm256_blendv_epi8(best, v, take);
+			best_pos = _mm256_blendv_epi8(best_pos, pos, take);
+			found = _mm256_or_si256(found, candidate);
+			pos = _mm256_add_epi32(pos, eight);
+		}
+
+		int lane_best[8], lane_pos[8], lane_found[8];
+		_mm256_storeu_si256((__m256i*)lane_best, best);
+		_mm256_storeu_si256((__m256i*)lane_pos, best_pos);
+		_mm256_storeu_si256((__m256i*)lane_found, found);
+		int b_value = 0;
+		for (int l = 0; l < 8; l++)
+		{
+			if (!lane_found[l]) continue;
+			size_t p = (size_t)lane_pos[l];
+			if (r.nearest == NOT_FOUND || (back ? lane_best[l] > b_value : lane_best[l] < b_value) ||
+				(lane_best[l] == b_value && p < r.nearest))
+			{
+				b_value = lane_best[l];
+				r.nearest = p;
+			}
+		}
+
+		// what is left is less than 8 boxes, and comes after all of the above
+		NearestBoxes t = nearest_scalar<dir>(advance(b, k), n - k, q, limit);
+		if (r.touching == NOT_FOUND && t.touching != NOT_FOUND)
+			r.touching = k + t.touching;
+		if (t.nearest != NOT_FOUND)
+		{
+			int v = value[k + t.nearest];
+			if (r.nearest == NOT_FOUND || (back ? v > b_value : v < b_value))
+				r.nearest = k + t.nearest;
+		}
+		return r;
+	}
+#endif
+
+	struct Kernels
+	{
+		size_t (*first_intersect)(const BoxArrays& b, size_t n, const Hitbox& q);
+		NearestBoxes (*nearest[4])(const BoxArrays& b, size_t n, const Hitbox& q, int limit);
+		const char* name;
+	};
+
+	static const Kernels SCALAR_KERNELS = {
+		first_intersect_scalar,
+		{
+			nearest_scalar<Direction::LEFT>, nearest_scalar<Direction::UP>,
+			nearest_scalar<Direction::RIGHT>, nearest_scalar<Direction::DOWN>
+		},
+		"scalar"
+	};
+
+#if IWEMU_HAS_AVX2
+	static const Kernels AVX2_KERNELS = {
+		first_intersect_avx2,
+		{
+			nearest_avx2<Direction::LEFT>, nearest_avx2<Direction::UP>,
+			nearest_avx2<Direction::RIGHT>, nearest_avx2<Direction::DOWN>
+		},
+		"avx2"
+	};
+#endif
+
+	static const Kernels* best_kernels()
+	{
+#if IWEMU_HAS_AVX2
+		if (has_avx2()) return &AVX2_KERNELS;
+#endif
+		return &SCALAR_KERNELS;
+	}
+
+	// picked on the first call, not on static initialization, so scenes made
+	// by static constructors of other files get them as well.
+	// atomic, since use_simd() can change it while threads of a SceneBatch read it.
+	// both tables give the same answers, so it doesn't matter which one a call gets
+	static std::atomic<const Kernels*>& kernels()
+	{
+		static std::atomic<const Kernels*> k(best_kernels());
+		return k;
+	}
+
+	size_t first_intersect(const BoxArrays& boxes, size_t n, const Hitbox& hbox)
+	{
+		return kernels().load(std::memory_order_relaxed)->first_intersect(boxes, n, hbox);
+	}
+
+	NearestBoxes nearest_boxes(const BoxArrays& boxes, size_t n, Direction dir, const Hitbox& hbox, int limit)
+	{
+		return kernels().load(std::memory_order_relaxed)->nearest[(int)dir](boxes, n, hbox, limit);
+	}
+
+	bool use_simd(bool on)
+	{
+		const Kernels* k = on ? best_kernels() : &SCALAR_KERNELS;
+		kernels().store(k, std::memory_order_relaxed);
+		return k != &SCALAR_KERNELS || !on;
+	}
+
+	const char* kernels_name()
+	{
+		return kernels().load(std::memory_order_relaxed)->name;
+	}
+}
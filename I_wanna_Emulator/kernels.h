@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include "hitbox.h"
+
+namespace iwemu
+{
+	// borders of boxes as separate arrays, so they can be tested 8 at a time.
+	// box k is [x[k], right[k]) x [y[k], bottom[k])
+	struct BoxArrays
+	{
+		const int* x;
+		const int* y;
+		const int* right;
+		const int* bottom;
+	};
+
+	const size_t NOT_FOUND = (size_t)-1;
+	// runs shorter than this aren't worth a call, a plain loop over them is faster
+	const size_t SIMD_MIN = 8;
+
+	// position of the first box that intersects hbox, NOT_FOUND if there is none
+	size_t first_intersect(const BoxArrays& boxes, size_t n, const Hitbox& hbox);
+
+	enum class Direction
+	{
+		LEFT, UP, RIGHT, DOWN
+	};
+
+	// the only boxes project_* can give the smallest distance for, out of a run of boxes
+	struct NearestBoxes
+	{
+		// first box that intersects the collidable, projection on it is 0
+		size_t touching;
+		// first of the closest boxes in the direction, that are in the way of the collidable
+		// but don't intersect it. closest means biggest right (or bottom) for left (or up),
+		// smallest x (or y) for right (or down)
+		size_t nearest;
+	};
+	// hbox is the collidable rounded to pixels. boxes are in the direction if their x (or y) is
+	// <= limit for left and up, >= limit for right and down
+	NearestBoxes nearest_boxes(const BoxArrays& boxes, size_t n, Direction dir, const Hitbox& hbox, int limit);
+
+	// kernels are picked on the first use, by what the cpu can do.
+	// use_simd(false) goes back to the plain loops, use_simd(true) returns false if there is no simd to use.
+	// it can be called while other threads run scenes
+	bool use_simd(bool on);
+	// "avx2" or "scalar"
+	const char* kernels_name();
+}
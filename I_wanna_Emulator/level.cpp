@@ -0,0 +1,261 @@
+#include "level.h"
+
+#include <string.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace iwemu
+{
+	static const char LEVEL_MAGIC[4] = { 'I', 'W', 'L', 'V' };
+	// written as it is in memory, so a file of the other byte order reads as something else
+	static const uint32_t LEVEL_BYTE_ORDER = 0x01020304;
+	// sections are this far apart, so arrays in a mapping are aligned for anything
+	static const uint64_t SECTION_ALIGN = 64;
+
+	// arrays of the file, in the order they go in
+	enum Section
+	{
+		SOLIDS, SEGMENTS, COLLIDABLES,
+		MERGED_BOXES, MERGED_OFFSETS, MERGED_PARTS, MERGED_COLS,
+		MERGED_SEGMENTS, MERGED_SEGMENT_OFFSETS, MERGED_SEGMENT_PARTS,
+		SOLID_OFFSETS, CELL_SOLIDS, SOLID_X, SOLID_Y, SOLID_RIGHT, SOLID_BOTTOM,
+		SEGMENT_OFFSETS, CELL_SEGMENTS,
+		SECTIONS
+	};
+
+	static const size_t SECTION_SIZES[SECTIONS] = {
+		sizeof(Hitbox), sizeof(Segment), sizeof(Hitbox),
+		sizeof(Hitbox), sizeof(unsigned int), sizeof(unsigned int), sizeof(unsigned int),
+		sizeof(Segment), sizeof(unsigned int), sizeof(unsigned int),
+		sizeof(unsigned int), sizeof(unsigned int), sizeof(int), sizeof(int), sizeof(int), sizeof(int),
+		sizeof(unsigned int), sizeof(unsigned int)
+	};
+
+	struct LevelHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t byte_order;
+		// sizes of the structs, in case the compiler lays them out differently
+		uint32_t hitbox_size, segment_size;
+		int32_t cell_size, x, y, cols, rows;
+		// where each array starts from the beginning of the file, and how many elements it has
+		uint64_t offsets[SECTIONS];
+		uint64_t counts[SECTIONS];
+	};
+
+	// an array to be written or checked
+	struct SectionArray
+	{
+		const void* data;
+		uint64_t count;
+	};
+
+	static void level_sections(const Level& level, const SolidGrid::StaticArrays& a, SectionArray* dest)
+	{
+		size_t cells = a.cells();
+		uint64_t packed_solids = a.solid_offsets[cells];
+		uint64_t merged_parts = a.merged_solids.offsets[a.merged_solids.boxesC];
+		uint64_t merged_segment_parts = a.merged_segments.offsets[a.merged_segments.segmentsC];
+		dest[SOLIDS] = { level.solids, level.solidsC };
+		dest[SEGMENTS] = { level.segments, level.segmentsC };
+		dest[COLLIDABLES] = { level.collidables, level.collidablesC };
+		dest[MERGED_BOXES] = { a.merged_solids.boxes, a.merged_solids.boxesC };
+		dest[MERGED_OFFSETS] = { a.merged_solids.offsets, a.merged_solids.boxesC + 1 };
+		dest[MERGED_PARTS] = { a.merged_solids.parts, merged_parts };
+		dest[MERGED_COLS] = { a.merged_solids.cols, a.merged_solids.boxesC };
+		dest[MERGED_SEGMENTS] = { a.merged_segments.segments, a.merged_segments.segmentsC };
+		dest[MERGED_SEGMENT_OFFSETS] = { a.merged_segments.offsets, a.merged_segments.segmentsC + 1 };
+		dest[MERGED_SEGMENT_PARTS] = { a.merged_segments.parts, merged_segment_parts };
+		dest[SOLID_OFFSETS] = { a.solid_offsets, cells + 1 };
+		dest[CELL_SOLIDS] = { a.solids, packed_solids };
+		dest[SOLID_X] = { a.solid_x, packed_solids };
+		dest[SOLID_Y] = { a.solid_y, packed_solids };
+		dest[SOLID_RIGHT] = { a.solid_right, packed_solids };
+		dest[SOLID_BOTTOM] = { a.solid_bottom, packed_solids };
+		dest[SEGMENT_OFFSETS] = { a.segment_offsets, cells + 1 };
+		dest[CELL_SEGMENTS] = { a.segments, a.segment_offsets[cells] };
+	}
+
+	void build_level(Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC,
+		const Hitbox* collidables, size_t collidablesC, Level& dest, int cell_size)
+	{
+		dest.solids = solids;
+		dest.solidsC = solidsC;
+		dest.segments = segments;
+		dest.segmentsC = segmentsC;
+		dest.collidables = collidables;
+		dest.collidablesC = collidablesC;
+		dest.grid = SolidGrid(cell_size);
+		dest.grid.build(solids, solidsC, segments, segmentsC);
+		dest.file.reset();
+	}
+
+	bool write_level(FILE* f, const Level& level)
+	{
+		const SolidGrid::StaticArrays& a = level.grid.static_arrays();
+		LevelHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, LEVEL_MAGIC, 4);
+		header.version = LEVEL_VERSION;
+		header.byte_order = LEVEL_BYTE_ORDER;
+		header.hitbox_size = sizeof(Hitbox);
+		header.segment_size = sizeof(Segment);
+		header.cell_size = a.cell_size;
+		header.x = a.x;
+		header.y = a.y;
+		header.cols = a.cols;
+		header.rows = a.rows;
+		SectionArray sections[SECTIONS];
+		level_sections(level, a, sections);
+		uint64_t at = sizeof(LevelHeader);
+		for (int s = 0; s < SECTIONS; s++)
+		{
+			at = (at + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+			header.offsets[s] = at;
+			header.counts[s] = sections[s].count;
+			at += sections[s].count * SECTION_SIZES[s];
+		}
+
+		if (fwrite(&header, sizeof(header), 1, f) != 1) return false;
+		static const char zeros[SECTION_ALIGN] = {};
+		uint64_t written = sizeof(LevelHeader);
+		for (int s = 0; s < SECTIONS; s++)
+		{
+			size_t pad = (size_t)(header.offsets[s] - written);
+			size_t bytes = (size_t)sections[s].count * SECTION_SIZES[s];
+			if (pad && fwrite(zeros, 1, pad, f) != pad) return false;
+			if (bytes && fwrite(sections[s].data, 1, bytes, f) != bytes) return false;
+			written = header.offsets[s] + bytes;
+		}
+		return true;
+	}
+
+	// a file mapped copy-on-write, unmapped when the last one who uses it lets go
+	class Mapping
+	{
+	public:
+		char* data = 0;
+		size_t size = 0;
+
+		bool open(const char* path)
+		{
+#ifdef _WIN32
+			HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+			if (file == INVALID_HANDLE_VALUE) return false;
+			LARGE_INTEGER size;
+			HANDLE mapping = 0;
+			if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+				mapping = CreateFileMappingA(file, 0, PAGE_WRITECOPY, 0, 0, 0);
+			CloseHandle(file);
+			if (!mapping) return false;
+			// the view keeps the mapping open
+			this->data = (char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+			CloseHandle(mapping);
+			if (!this->data) return false;
+			this->size = (size_t)size.QuadPart;
+#else
+			int fd = ::open(path, O_RDONLY);
+			if (fd < 0) return false;
+			struct stat st;
+			void* p = MAP_FAILED;
+			if (fstat(fd, &st) == 0 && st.st_size > 0)
+				p = mmap(0, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (p == MAP_FAILED) return false;
+			this->data = (char*)p;
+			this->size = (size_t)st.st_size;
+#endif
+			return true;
+		}
+
+		~Mapping()
+		{
+			if (!this->data) return;
+#ifdef _WIN32
+			UnmapViewOfFile(this->data);
+#else
+			munmap(this->data, this->size);
+#endif
+		}
+	};
+
+	bool open_level(const char* path, Level& dest)
+	{
+		std::shared_ptr<Mapping> file = std::make_shared<Mapping>();
+		return file->open(path) && open_level(file->data, file->size, file, dest);
+	}
+
+	bool open_level(void* data, size_t size, std::shared_ptr<const void> owner, Level& dest)
+	{
+		if (size < sizeof(LevelHeader) || (uintptr_t)data % sizeof(uint64_t) != 0) return false;
+		const LevelHeader& header = *(const LevelHeader*)data;
+		if (memcmp(header.magic, LEVEL_MAGIC, 4) != 0 || header.version != LEVEL_VERSION || header.byte_order != LEVEL_BYTE_ORDER ||
+			header.hitbox_size != sizeof(Hitbox) || header.segment_size != sizeof(Segment) ||
+			header.cell_size <= 0 || header.cols <= 0 || header.rows <= 0)
+			return false;
+		// every array has to be in the file and aligned, and the last offsets of the arrays of offsets
+		// have to be there, so the sizes of the arrays they tell about can be checked
+		for (int s = 0; s < SECTIONS; s++)
+		{
+			uint64_t offset = header.offsets[s];
+			if (offset % SECTION_ALIGN != 0 || offset > size || header.counts[s] > (size - offset) / SECTION_SIZES[s])
+				return false;
+		}
+		uint64_t cells = (uint64_t)header.cols * (uint64_t)header.rows;
+		if (header.counts[SOLID_OFFSETS] != cells + 1 || header.counts[SEGMENT_OFFSETS] != cells + 1 ||
+			header.counts[MERGED_OFFSETS] != header.counts[MERGED_BOXES] + 1 ||
+			header.counts[MERGED_SEGMENT_OFFSETS] != header.counts[MERGED_SEGMENTS] + 1)
+			return false;
+		char* base = (char*)data;
+		SolidGrid::StaticArrays a;
+		a.cell_size = header.cell_size;
+		a.x = header.x;
+		a.y = header.y;
+		a.cols = header.cols;
+		a.rows = header.rows;
+		a.merged_solids = {
+			(const Hitbox*)(base + header.offsets[MERGED_BOXES]), (size_t)header.counts[MERGED_BOXES],
+			(const unsigned int*)(base + header.offsets[MERGED_OFFSETS]),
+			(const unsigned int*)(base + header.offsets[MERGED_PARTS]),
+			(const unsigned int*)(base + header.offsets[MERGED_COLS])
+		};
+		a.merged_segments = {
+			(const Segment*)(base + header.offsets[MERGED_SEGMENTS]), (size_t)header.counts[MERGED_SEGMENTS],
+			(const unsigned int*)(base + header.offsets[MERGED_SEGMENT_OFFSETS]),
+			(const unsigned int*)(base + header.offsets[MERGED_SEGMENT_PARTS])
+		};
+		a.solid_offsets = (const unsigned int*)(base + header.offsets[SOLID_OFFSETS]);
+		a.solids = (const unsigned int*)(base + header.offsets[CELL_SOLIDS]);
+		a.solid_x = (const int*)(base + header.offsets[SOLID_X]);
+		a.solid_y = (const int*)(base + header.offsets[SOLID_Y]);
+		a.solid_right = (const int*)(base + header.offsets[SOLID_RIGHT]);
+		a.solid_bottom = (const int*)(base + header.offsets[SOLID_BOTTOM]);
+		a.segment_offsets = (const unsigned int*)(base + header.offsets[SEGMENT_OFFSETS]);
+		a.segments = (const unsigned int*)(base + header.offsets[CELL_SEGMENTS]);
+
+		Level level;
+		level.solids = (Hitbox*)(base + header.offsets[SOLIDS]);
+		level.solidsC = (size_t)header.counts[SOLIDS];
+		level.segments = (Segment*)(base + header.offsets[SEGMENTS]);
+		level.segmentsC = (size_t)header.counts[SEGMENTS];
+		level.collidables = (const Hitbox*)(base + header.offsets[COLLIDABLES]);
+		level.collidablesC = (size_t)header.counts[COLLIDABLES];
+		SectionArray sections[SECTIONS];
+		level_sections(level, a, sections);
+		for (int s = 0; s < SECTIONS; s++)
+			if (sections[s].count != header.counts[s]) return false;
+		level.grid.build(a, owner, level.solids, level.solidsC, level.segments, level.segmentsC);
+		level.file = owner;
+		dest = level;
+		return true;
+	}
+}
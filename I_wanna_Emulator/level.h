@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <memory>
+#include "hitbox.h"
+#include "grid.h"
+
+namespace iwemu
+{
+	// a room: its solids, segments and where collidables start, with the static part of the grid
+	// already built. SolidScene can be made from it without indexing anything.
+	//
+	// on disk it's the arrays the way they are in memory, so open_level() maps the file and uses it
+	// right where it is: nothing is parsed, copied, merged or indexed when a room is opened.
+	// a file is only opened on the kind of machine it was written on: another version of the format,
+	// byte order or layout of the structs makes open_level() fail. what's in the arrays is trusted
+	struct Level
+	{
+		// pages of a mapped file are private to the process, and get copied the first time they are
+		// written, so movers move without the file changing. scenes running on one level at once
+		// need their own copies of solids and segments, same as with arrays
+		Hitbox* solids = 0;
+		size_t solidsC = 0;
+		Segment* segments = 0;
+		size_t segmentsC = 0;
+		// where collidables start, in whole pixels, so it's the same file for every Scalar
+		const Hitbox* collidables = 0;
+		size_t collidablesC = 0;
+		// index of the solids and segments. scenes made from the level share its static part
+		SolidGrid grid;
+		// the mapping everything points into, 0 for a level that was built in memory.
+		// the grid and scenes made from the level keep it too
+		std::shared_ptr<const void> file;
+	};
+
+	// "IWLV", then this, then the rest
+	const uint32_t LEVEL_VERSION = 1;
+
+	// a level out of arrays in memory, that have to live as long as it does
+	void build_level(Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC,
+		const Hitbox* collidables, size_t collidablesC, Level& dest, int cell_size = SolidGrid::DEFAULT_CELL_SIZE);
+	bool write_level(FILE* f, const Level& level);
+	// maps a file made by write_level(). dest is left alone if it can't
+	bool open_level(const char* path, Level& dest);
+	// same, but the file is already in memory at data, aligned to 8 bytes. owner keeps it there,
+	// and is kept by the level like a mapping (chunks of a world are read like this)
+	bool open_level(void* data, size_t size, std::shared_ptr<const void> owner, Level& dest);
+}
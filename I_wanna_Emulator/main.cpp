@@ -1,19 +1,15 @@
 #include <stdio.h>
+#include <vector>
 #include <raylib.h>
 #include "solids.h"
+#include "player.h"
+#include "level.h"
 
 
-const int gravDir = 1;
-const int runSpeed = 3;
-const double maxVSpeed = 9.0;
-const double jumpForce = 8.5;
-const double djumpForce = 7.0;
-const double gravityCoef = 0.4;
-int djump = 1;
-const int maxDJump = 1;
+int djump = iwemu::maxDJump;
 
 
-int main(void)
+int main(int argc, char** argv)
 {
 	InitWindow(800, 608, "Collisions demo");
 
@@ -28,11 +24,23 @@ int main(void)
 		iwemu::Segment({288, 212, 32, true, true, false, 0, 0})
 	};
 	size_t segmentsC = sizeof(segments) / sizeof(segments[0]);
-	iwemu::BBox collidables[] = {
-		iwemu::BBox({256.0, 298.0, 11, 21, 0.0, 0.0})
+	iwemu::Hitbox start[] = {
+		iwemu::Hitbox({256, 298, 11, 21, 0, 0})
 	};
-	size_t collidablesC = sizeof(collidables) / sizeof(collidables[0]);
-	iwemu::SolidScene scene(1, solids, solidsC, segments, segmentsC, collidables, collidablesC);
+
+	// a room written with write_level() can be given instead of this one
+	iwemu::Level level;
+	if (argc < 2 || !iwemu::open_level(argv[1], level))
+	{
+		if (argc >= 2)
+			printf("Can't open level %s\n", argv[1]);
+		iwemu::build_level(solids, solidsC, segments, segmentsC, start, 1, level);
+	}
+	// the player is the first collidable, so there has to be one
+	std::vector<iwemu::BBox> collidables(level.collidablesC ? level.collidablesC : 1, iwemu::BBox({256, 298, 11, 21, 0, 0}));
+	for (size_t i = 0; i < level.collidablesC; i++)
+		iwemu::to_bbox(level.collidables[i], collidables[i]);
+	iwemu::SolidScene scene(level, 1, collidables.data(), collidables.size());
 
 	SetTargetFPS(50);
 	while (!WindowShouldClose())
@@ -43,97 +51,67 @@ int main(void)
 			scene.alive[0] = true;
 			player.x = GetMouseX();
 			player.y = GetMouseY();
+			scene.refresh_contact(0);
 		}
-		char h = 0;
+		iwemu::PlayerInput input = { 0, IsKeyPressed(KEY_LEFT_SHIFT), IsKeyReleased(KEY_LEFT_SHIFT) };
 		if (IsKeyDown(KEY_RIGHT))
-			h = 1;
+			input.h = 1;
 		else if (IsKeyDown(KEY_LEFT))
-			h = -1;
-		bool standing = scene.project_free_down(player) <= 1.0;
-		if (h)
-		{
-			player.dx = h * runSpeed;
-		}
-		else
-		{
-			player.dx = 0.0;
-		}
-
-		if (gravDir * player.dy > maxVSpeed)
-		{
-			player.dy = gravDir * maxVSpeed;
-		}
-		if (standing)
-		{
-			djump = maxDJump;
-		}
-
-		if (IsKeyPressed(KEY_LEFT_SHIFT))
+			input.h = -1;
+		switch (iwemu::control_player(scene.grav_dir, iwemu::standing(scene, 0), player, djump, input))
 		{
-			if (standing)
-			{
-				printf("Ground jump\n");
-				player.dy = -jumpForce;
-			}
-			else if (djump > 0)
-			{
-				printf("Air jump\n");
-				player.dy = -djumpForce;
-				djump--;
-			}
-
-		}
-		if (IsKeyReleased(KEY_LEFT_SHIFT))
-		{
-			if (player.dy * gravDir < 0.0)
-			{
-				player.dy *= 0.45;
-			}
+		case iwemu::Jump::GROUND:
+			printf("Ground jump\n");
+		break;
+		case iwemu::Jump::AIR:
+			printf("Air jump\n");
+		break;
+		default:
+		break;
 		}
-		player.dy += gravDir * gravityCoef;
 		scene.update();
 
 		char txt[64];
-		snprintf(txt, 64, "%f %f", collidables[0].x + 5.0, collidables[0].y + 12.0);
+		snprintf(txt, 64, "%f %f", (double)collidables[0].x + 5.0, (double)collidables[0].y + 12.0);
 		BeginDrawing();
 			ClearBackground(PURPLE);
 			DrawText(txt, 64, 64, 18, BLACK);
-			for (unsigned int i = 0; i < solidsC; i++)
+			for (unsigned int i = 0; i < level.solidsC; i++)
 			{
-				DrawRectangle(solids[i].x, solids[i].y, solids[i].width, solids[i].height, VIOLET);
+				DrawRectangle(level.solids[i].x, level.solids[i].y, level.solids[i].width, level.solids[i].height, VIOLET);
 			}
-			for (unsigned int i = 0; i < segmentsC; i++)
+			for (unsigned int i = 0; i < level.segmentsC; i++)
 			{
-				if (segments[i].vertical)
+				if (level.segments[i].vertical)
 				{
-					if (segments[i].block_lt)
-						DrawLine(segments[i].x, segments[i].y, segments[i].x, segments[i].y + segments[i].length, BLACK);
+					if (level.segments[i].block_lt)
+						DrawLine(level.segments[i].x, level.segments[i].y, level.segments[i].x, level.segments[i].y + level.segments[i].length, BLACK);
 					else 
-						DrawLine(segments[i].x, segments[i].y, segments[i].x, segments[i].y + segments[i].length, GRAY);
-					if (segments[i].block_rb)
-						DrawLine(segments[i].x + 1, segments[i].y, segments[i].x + 1, segments[i].y + segments[i].length, BLACK);
+						DrawLine(level.segments[i].x, level.segments[i].y, level.segments[i].x, level.segments[i].y + level.segments[i].length, GRAY);
+					if (level.segments[i].block_rb)
+						DrawLine(level.segments[i].x + 1, level.segments[i].y, level.segments[i].x + 1, level.segments[i].y + level.segments[i].length, BLACK);
 					else 
-						DrawLine(segments[i].x + 1, segments[i].y, segments[i].x + 1, segments[i].y + segments[i].length, GRAY);
+						DrawLine(level.segments[i].x + 1, level.segments[i].y, level.segments[i].x + 1, level.segments[i].y + level.segments[i].length, GRAY);
 				}
 				else
 				{
-					if (segments[i].block_lt)
-						DrawLine(segments[i].x, segments[i].y, segments[i].x + segments[i].length, segments[i].y, BLACK);
+					if (level.segments[i].block_lt)
+						DrawLine(level.segments[i].x, level.segments[i].y, level.segments[i].x + level.segments[i].length, level.segments[i].y, BLACK);
 					else 
-						DrawLine(segments[i].x, segments[i].y, segments[i].x + segments[i].length, segments[i].y, GRAY);
-					if (segments[i].block_rb)
-						DrawLine(segments[i].x, segments[i].y + 1, segments[i].x + segments[i].length, segments[i].y + 1, BLACK);
+						DrawLine(level.segments[i].x, level.segments[i].y, level.segments[i].x + level.segments[i].length, level.segments[i].y, GRAY);
+					if (level.segments[i].block_rb)
+						DrawLine(level.segments[i].x, level.segments[i].y + 1, level.segments[i].x + level.segments[i].length, level.segments[i].y + 1, BLACK);
 					else
-						DrawLine(segments[i].x, segments[i].y + 1, segments[i].x + segments[i].length, segments[i].y + 1, GRAY);
+						DrawLine(level.segments[i].x, level.segments[i].y + 1, level.segments[i].x + level.segments[i].length, level.segments[i].y + 1, GRAY);
 				}
 			}
 			if (!scene.alive[0])
 			{
-				DrawRectangle(collidables[0].x, collidables[0].y, collidables[0].width, collidables[0].height, RED);
+				DrawRectangle((double)collidables[0].x, (double)collidables[0].y, collidables[0].width, collidables[0].height, RED);
 			}
 			else
 			{
-				DrawRectangle(collidables[0].x, collidables[0].y, collidables[0].width, collidables[0].height, MAGENTA);
+				DrawRectangle((double)collidables[0].x, (double)collidables[0].y, collidables[0].width, collidables[0].height, MAGENTA);
 			}
 		EndDrawing();
 	}
@@ -0,0 +1,203 @@
+#include "merge.h"
+
+#include <algorithm>
+#include "grid.h"
+
+namespace iwemu
+{
+	// blocks of one size are sorted by position, so the neighbours of a block can be looked up
+	struct Block
+	{
+		unsigned int width, height;
+		int y, x;
+		unsigned int i;
+	};
+
+	inline bool operator<(const Block& a, const Block& b)
+	{
+		if (a.width != b.width) return a.width < b.width;
+		if (a.height != b.height) return a.height < b.height;
+		if (a.y != b.y) return a.y < b.y;
+		if (a.x != b.x) return a.x < b.x;
+		return a.i < b.i;
+	}
+
+	// merged objects are put in the order of their first part
+	static std::vector<unsigned int> by_first_part(const std::vector<unsigned int>& first)
+	{
+		std::vector<unsigned int> order(first.size());
+		for (size_t k = 0; k < order.size(); k++)
+			order[k] = (unsigned int)k;
+		std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return first[a] < first[b]; });
+		return order;
+	}
+
+	// parts of object m of offsets/parts, appended to dest_parts
+	static void copy_parts(const std::vector<unsigned int>& offsets, const std::vector<unsigned int>& parts, unsigned int m,
+		std::vector<unsigned int>& dest_offsets, std::vector<unsigned int>& dest_parts)
+	{
+		dest_parts.insert(dest_parts.end(), parts.begin() + offsets[m], parts.begin() + offsets[m + 1]);
+		dest_offsets.push_back((unsigned int)dest_parts.size());
+	}
+
+	void merge_solids(const Hitbox* solids, size_t solidsC, MergedSolidsData& dest)
+	{
+		std::vector<Block> blocks;
+		for (size_t i = 0; i < solidsC; i++)
+		{
+			const Hitbox& s = solids[i];
+			if (!moving(s)) blocks.push_back({ s.width, s.height, s.y, s.x, (unsigned int)i });
+		}
+		std::sort(blocks.begin(), blocks.end());
+		std::vector<bool> used(blocks.size(), false);
+		// position of the block of this size at x, y that isn't in a merged box yet, -1 if there is none.
+		// of a few blocks at the same place, only the first one is merged with others
+		auto find = [&](const Block& like, int x, int y) -> long {
+			Block key = { like.width, like.height, y, x, 0 };
+			size_t p = std::lower_bound(blocks.begin(), blocks.end(), key) - blocks.begin();
+			if (p == blocks.size() || blocks[p].width != like.width || blocks[p].height != like.height ||
+				blocks[p].x != x || blocks[p].y != y || used[p])
+				return -1;
+			return (long)p;
+		};
+
+		MergedSolidsData merged;
+		merged.offsets.assign(1, 0);
+		std::vector<unsigned int> first;
+		std::vector<size_t> run;
+		for (size_t b = 0; b < blocks.size(); b++)
+		{
+			if (used[b]) continue;
+			const Block& s = blocks[b];
+			run.assign(1, b);
+			size_t cols = 1, rows = 1;
+			if (!thin(solids[s.i]))
+			{	// as far to the right as it goes, then down while the rows are whole
+				for (long p; (p = find(s, s.x + (int)(cols * s.width), s.y)) >= 0; cols++)
+					run.push_back((size_t)p);
+				for (;; rows++)
+				{
+					size_t was = run.size();
+					for (size_t c = 0; c < cols; c++)
+					{
+						long p = find(s, s.x + (int)(c * s.width), s.y + (int)(rows * s.height));
+						if (p < 0) break;
+						run.push_back((size_t)p);
+					}
+					if (run.size() - was < cols)
+					{
+						run.resize(was);
+						break;
+					}
+				}
+			}
+			unsigned int low = s.i;
+			for (size_t k = 0; k < run.size(); k++)
+			{
+				used[run[k]] = true;
+				merged.parts.push_back(blocks[run[k]].i);
+				low = std::min(low, blocks[run[k]].i);
+			}
+			merged.offsets.push_back((unsigned int)merged.parts.size());
+			merged.boxes.push_back({ s.x, s.y, (unsigned int)(cols * s.width), (unsigned int)(rows * s.height), 0, 0 });
+			merged.cols.push_back((unsigned int)cols);
+			first.push_back(low);
+		}
+
+		std::vector<unsigned int> order = by_first_part(first);
+		dest.boxes.clear();
+		dest.cols.clear();
+		dest.parts.clear();
+		dest.offsets.assign(1, 0);
+		for (unsigned int m : order)
+		{
+			dest.boxes.push_back(merged.boxes[m]);
+			dest.cols.push_back(merged.cols[m]);
+			copy_parts(merged.offsets, merged.parts, m, dest.offsets, dest.parts);
+		}
+	}
+
+	// segments on one line, sorted by where they start
+	struct Line
+	{
+		bool vertical, block_lt, block_rb;
+		int line, start;
+		unsigned int i;
+	};
+
+	inline bool operator<(const Line& a, const Line& b)
+	{
+		if (a.vertical != b.vertical) return a.vertical < b.vertical;
+		if (a.block_lt != b.block_lt) return a.block_lt < b.block_lt;
+		if (a.block_rb != b.block_rb) return a.block_rb < b.block_rb;
+		if (a.line != b.line) return a.line < b.line;
+		if (a.start != b.start) return a.start < b.start;
+		return a.i < b.i;
+	}
+
+	void merge_segments(const Segment* segments, size_t segmentsC, MergedSegmentsData& dest)
+	{
+		std::vector<Line> lines;
+		for (size_t i = 0; i < segmentsC; i++)
+		{
+			const Segment& s = segments[i];
+			if (!moving(s))
+				lines.push_back({ s.vertical, s.block_lt, s.block_rb, s.vertical ? s.x : s.y, s.vertical ? s.y : s.x, (unsigned int)i });
+		}
+		std::sort(lines.begin(), lines.end());
+
+		MergedSegmentsData merged;
+		merged.offsets.assign(1, 0);
+		std::vector<unsigned int> first;
+		for (size_t b = 0; b < lines.size();)
+		{
+			const Line& s = lines[b];
+			int end = s.start + (int)segments[s.i].length;
+			unsigned int low = s.i;
+			size_t e = b + 1;
+			// the next one has to start right where this one ends. segments of zero length stay alone
+			while (segments[s.i].length && e < lines.size() && lines[e].vertical == s.vertical &&
+				lines[e].block_lt == s.block_lt && lines[e].block_rb == s.block_rb &&
+				lines[e].line == s.line && lines[e].start == end && segments[lines[e].i].length)
+			{
+				end += (int)segments[lines[e].i].length;
+				low = std::min(low, lines[e].i);
+				e++;
+			}
+			Segment m = segments[s.i];
+			m.length = (unsigned int)(end - s.start);
+			merged.segments.push_back(m);
+			for (size_t k = b; k < e; k++)
+				merged.parts.push_back(lines[k].i);
+			merged.offsets.push_back((unsigned int)merged.parts.size());
+			first.push_back(low);
+			b = e;
+		}
+
+		std::vector<unsigned int> order = by_first_part(first);
+		dest.segments.clear();
+		dest.parts.clear();
+		dest.offsets.assign(1, 0);
+		for (unsigned int m : order)
+		{
+			dest.segments.push_back(merged.segments[m]);
+			copy_parts(merged.offsets, merged.parts, m, dest.offsets, dest.parts);
+		}
+	}
+
+	bool intersect_parts(const MergedSolids& merged, size_t k, const Hitbox* solids, const Hitbox& hbox)
+	{
+		for (unsigned int p = merged.offsets[k]; p < merged.offsets[k + 1]; p++)
+			if (intersect(hbox, solids[merged.parts[p]]))
+				return true;
+		return false;
+	}
+
+	bool intersect_parts(const MergedSegments& merged, size_t k, const Segment* segments, const Hitbox& hbox)
+	{
+		for (unsigned int p = merged.offsets[k]; p < merged.offsets[k + 1]; p++)
+			if (intersect(hbox, segments[merged.parts[p]]))
+				return true;
+		return false;
+	}
+}
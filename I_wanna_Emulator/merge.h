@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include "hitbox.h"
+
+namespace iwemu
+{
+	// static blocks of the same size that fill a rectangle together become one box, and static
+	// segments that continue each other become one segment, so there are fewer things to look at.
+	// a merged object answers the same as its parts, except for boxes of zero width or height
+	// (they can fall right between two parts), and for boxes inside of it (a part next to them
+	// can be half a pixel closer than 0). for those, and for the index of the closest part,
+	// queries go down to the parts
+	// merged objects are arrays, so they can be used right where they are: in the vectors of the
+	// Data structs below when the index is built, or in a mapped level file (level.h)
+	struct MergedSolids
+	{
+		const Hitbox* boxes;
+		size_t boxesC;
+		// box k is made of solids parts[offsets[k]] ... parts[offsets[k + 1] - 1],
+		// row after row of cols[k] parts of the same size
+		const unsigned int* offsets;
+		const unsigned int* parts;
+		const unsigned int* cols;
+
+		size_t parts_of(size_t k) const { return this->offsets[k + 1] - this->offsets[k]; }
+	};
+
+	struct MergedSegments
+	{
+		const Segment* segments;
+		size_t segmentsC;
+		// segment k is made of segments parts[offsets[k]] ... parts[offsets[k + 1] - 1],
+		// from the top (or the left) one
+		const unsigned int* offsets;
+		const unsigned int* parts;
+
+		size_t parts_of(size_t k) const { return this->offsets[k + 1] - this->offsets[k]; }
+	};
+
+	struct MergedSolidsData
+	{
+		std::vector<Hitbox> boxes;
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> parts;
+		std::vector<unsigned int> cols;
+
+		MergedSolids arrays() const
+		{
+			return { this->boxes.data(), this->boxes.size(), this->offsets.data(), this->parts.data(), this->cols.data() };
+		}
+	};
+
+	struct MergedSegmentsData
+	{
+		std::vector<Segment> segments;
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> parts;
+
+		MergedSegments arrays() const
+		{
+			return { this->segments.data(), this->segments.size(), this->offsets.data(), this->parts.data() };
+		}
+	};
+
+	// moving solids and segments are left out. merged objects come in the order of their first part
+	void merge_solids(const Hitbox* solids, size_t solidsC, MergedSolidsData& dest);
+	void merge_segments(const Segment* segments, size_t segmentsC, MergedSegmentsData& dest);
+
+	// boxes merged objects can answer differently for
+	inline bool thin(const Hitbox& hbox) { return hbox.width == 0 || hbox.height == 0; }
+	// does a part of merged object k intersect hbox. solids and segments are the ones that were merged
+	bool intersect_parts(const MergedSolids& merged, size_t k, const Hitbox* solids, const Hitbox& hbox);
+	bool intersect_parts(const MergedSegments& merged, size_t k, const Segment* segments, const Hitbox& hbox);
+}
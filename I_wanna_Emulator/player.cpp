@@ -0,0 +1,64 @@
+#include "player.h"
+
+namespace iwemu
+{
+	const int runSpeed = 3;
+	const Scalar maxVSpeed = Scalar(9.0);
+	const Scalar jumpForce = Scalar(8.5);
+	const Scalar djumpForce = Scalar(7.0);
+	const Scalar gravityCoef = Scalar(0.4);
+	const Scalar jumpCut = Scalar(0.45);
+
+	Jump control_player(SolidScene& scene, BBox& player, int& djump, const PlayerInput& input)
+	{
+		return control_player(scene.grav_dir, scene.project_free_down(player) <= 1, player, djump, input);
+	}
+
+	Jump control_player(int grav_dir, bool standing, BBox& player, int& djump, const PlayerInput& input)
+	{
+		int gravDir = grav_dir;
+		Jump jump = Jump::NONE;
+		if (input.h)
+		{
+			player.dx = input.h * runSpeed;
+		}
+		else
+		{
+			player.dx = 0;
+		}
+
+		if (gravDir * player.dy > maxVSpeed)
+		{
+			player.dy = gravDir * maxVSpeed;
+		}
+		if (standing)
+		{
+			djump = maxDJump;
+		}
+
+		if (input.jump_pressed)
+		{
+			if (standing)
+			{
+				jump = Jump::GROUND;
+				player.dy = -jumpForce;
+			}
+			else if (djump > 0)
+			{
+				jump = Jump::AIR;
+				player.dy = -djumpForce;
+				djump--;
+			}
+
+		}
+		if (input.jump_released)
+		{
+			if (player.dy * gravDir < 0)
+			{
+				player.dy *= jumpCut;
+			}
+		}
+		player.dy += gravDir * gravityCoef;
+		return jump;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "solids.h"
+
+namespace iwemu
+{
+	// what the player is holding/pressing during one frame
+	struct PlayerInput
+	{
+		char h;		// -1 left, 1 right, 0 none
+		bool jump_pressed;
+		bool jump_released;
+	};
+
+	enum class Jump
+	{
+		NONE, GROUND, AIR
+	};
+
+	const int maxDJump = 1;
+
+	// fangame movement: sets the speed of the player from the input,
+	// to be moved by the next scene.update(). djump is the number of air jumps left
+	Jump control_player(SolidScene& scene, BBox& player, int& djump, const PlayerInput& input);
+	// same, when it's known already if the player stands on something,
+	// like from the contacts of the last update()
+	Jump control_player(int grav_dir, bool standing, BBox& player, int& djump, const PlayerInput& input);
+
+	// what control_player() calls standing, for collidable k of the scene
+	inline bool standing(SolidScene& scene, size_t k)
+	{
+		return scene.touching(k, Direction::DOWN).dist <= 1;
+	}
+}
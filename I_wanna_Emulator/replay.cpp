@@ -0,0 +1,127 @@
+#include "replay.h"
+
+#include <string.h>
+
+namespace iwemu
+{
+	static const char MAGIC[4] = { 'I', 'W', 'R', 'L' };
+
+	// h + 1 in the low two bits, then pressed and released
+	static unsigned char pack(const PlayerInput& input)
+	{
+		return (unsigned char)((input.h + 1) | (input.jump_pressed << 2) | (input.jump_released << 3));
+	}
+
+	static PlayerInput unpack(unsigned char b)
+	{
+		return { (char)((b & 3) - 1), (b & 4) != 0, (b & 8) != 0 };
+	}
+
+	static bool write_u64(FILE* f, uint64_t v)
+	{
+		unsigned char b[8];
+		for (int i = 0; i < 8; i++)
+			b[i] = (unsigned char)(v >> (8 * i));
+		return fwrite(b, 1, 8, f) == 8;
+	}
+
+	static bool read_u64(FILE* f, uint64_t& v)
+	{
+		unsigned char b[8];
+		if (fread(b, 1, 8, f) != 8) return false;
+		v = 0;
+		for (int i = 0; i < 8; i++)
+			v |= (uint64_t)b[i] << (8 * i);
+		return true;
+	}
+
+	void ReplayLog::record(const PlayerInput* inputs, uint64_t hash)
+	{
+		this->inputs.insert(this->inputs.end(), inputs, inputs + this->playersC);
+		this->hashes.push_back(hash);
+	}
+
+	void step_players(SolidScene& scene, BBox* players, int* djumps, const PlayerInput* inputs, size_t playersC)
+	{
+		for (size_t k = 0; k < playersC; k++)
+		{
+			if (scene.alive[k])
+				control_player(scene, players[k], djumps[k], inputs[k]);
+		}
+		scene.update();
+	}
+
+	long long verify_replay(SolidScene& scene, BBox* collidables, const ReplayLog& log)
+	{
+		std::vector<int> djumps(log.playersC, maxDJump);
+		for (size_t f = 0; f < log.frames(); f++)
+		{
+			step_players(scene, collidables, djumps.data(), log.frame_inputs(f), log.playersC);
+			if (scene.state_hash() != log.hashes[f])
+				return (long long)f;
+		}
+		return -1;
+	}
+
+	bool write_replay_header(FILE* f, size_t playersC)
+	{
+		return fwrite(MAGIC, 1, 4, f) == 4 && write_u64(f, playersC);
+	}
+
+	bool write_replay_frame(FILE* f, const PlayerInput* inputs, size_t playersC, uint64_t hash)
+	{
+		for (size_t k = 0; k < playersC; k++)
+		{
+			if (fputc(pack(inputs[k]), f) == EOF) return false;
+		}
+		return write_u64(f, hash);
+	}
+
+	bool write_replay(FILE* f, const ReplayLog& log)
+	{
+		if (!write_replay_header(f, log.playersC)) return false;
+		for (size_t i = 0; i < log.frames(); i++)
+		{
+			if (!write_replay_frame(f, log.frame_inputs(i), log.playersC, log.hashes[i])) return false;
+		}
+		return true;
+	}
+
+	bool read_replay(FILE* f, ReplayLog& dest)
+	{
+		char magic[4];
+		uint64_t playersC;
+		if (fread(magic, 1, 4, f) != 4 || memcmp(magic, MAGIC, 4) != 0 || !read_u64(f, playersC))
+			return false;
+		// a frame is a byte for every player and the hash, so a broken header could ask for more players
+		// than there are bytes in the file. that is checked before anything is made for them
+		long here = ftell(f);
+		if (here >= 0 && fseek(f, 0, SEEK_END) == 0)
+		{
+			long end = ftell(f);
+			if (end < here || fseek(f, here, SEEK_SET) != 0) return false;
+			uint64_t left = (uint64_t)(end - here);
+			if (left > 0 && (playersC > left || left - playersC < 8)) return false;
+		}
+		dest.playersC = (size_t)playersC;
+		dest.inputs.clear();
+		dest.hashes.clear();
+		std::vector<PlayerInput> inputs;
+		for (;;)
+		{
+			int c = fgetc(f);
+			if (c == EOF) return true;
+			ungetc(c, f);
+			inputs.resize(dest.playersC);
+			for (size_t k = 0; k < dest.playersC; k++)
+			{
+				int b = fgetc(f);
+				if (b == EOF) return false;
+				inputs[k] = unpack((unsigned char)b);
+			}
+			uint64_t hash;
+			if (!read_u64(f, hash)) return false;
+			dest.record(inputs.data(), hash);
+		}
+	}
+}
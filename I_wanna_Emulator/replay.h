@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "player.h"
+
+namespace iwemu
+{
+	// inputs of a run and the state hash after every frame of it.
+	// players are the first collidables of the scene, in order
+	struct ReplayLog
+	{
+		size_t playersC = 0;
+		// playersC inputs for every frame
+		std::vector<PlayerInput> inputs;
+		std::vector<uint64_t> hashes;
+
+		size_t frames() const { return this->hashes.size(); }
+		const PlayerInput* frame_inputs(size_t frame) const { return this->inputs.data() + frame * this->playersC; }
+		void record(const PlayerInput* inputs, uint64_t hash);
+	};
+
+	// one frame of a replayable run: every player gets its input, then the scene is updated.
+	// djumps are kept between the frames by the caller, maxDJump at the start
+	void step_players(SolidScene& scene, BBox* players, int* djumps, const PlayerInput* inputs, size_t playersC);
+
+	// runs the log on a scene that is where the recorded run started,
+	// and tells the first frame where the state hash is not the recorded one, -1 if there is none
+	long long verify_replay(SolidScene& scene, BBox* collidables, const ReplayLog& log);
+
+	// file is "IWRL", the number of players, then for every frame a byte of input
+	// for every player and the hash, all little-endian. frames can be written as they go
+	bool write_replay_header(FILE* f, size_t playersC);
+	bool write_replay_frame(FILE* f, const PlayerInput* inputs, size_t playersC, uint64_t hash);
+	bool write_replay(FILE* f, const ReplayLog& log);
+	bool read_replay(FILE* f, ReplayLog& dest);
+}
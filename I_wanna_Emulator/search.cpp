@@ -0,0 +1,207 @@
+#include "search.h"
+
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include "batch.h"
+#include "hash.h"
+
+namespace iwemu
+{
+	// every input there is: left, nothing, right, each with jump pressed, released, or neither
+	static const PlayerInput choices[9] = {
+		{ -1, false, false }, { 0, false, false }, { 1, false, false },
+		{ -1, true, false }, { 0, true, false }, { 1, true, false },
+		{ -1, false, true }, { 0, false, true }, { 1, false, true },
+	};
+	static const size_t choicesC = 9;
+	static const unsigned int NO_PARENT = 0xffffffff;
+
+	// how the route got to a state
+	struct Node
+	{
+		unsigned int parent;
+		PlayerInput input;
+	};
+
+	// state still to be looked into
+	struct Open
+	{
+		unsigned int node;
+		int djump;
+		bool held;
+		bool valid;
+		double distance;
+		uint64_t hash;
+		SolidScene::Snapshot snap;
+	};
+
+	static inline uint64_t quantize(double v, double quantum)
+	{
+		return (uint64_t)llround(v / quantum);
+	}
+
+	// player is rounded to the quantum, movers are compared as they are,
+	// since where they are tells how far they are in their cycle
+	static uint64_t state_hash(const Open& state, size_t player, double quantum)
+	{
+		const SolidScene::Snapshot& snap = state.snap;
+		const BBox& p = snap.collidables[player];
+		uint64_t h = HASH_SEED;
+		h = hash_mix(h, quantize((double)p.x, quantum));
+		h = hash_mix(h, quantize((double)p.y, quantum));
+		h = hash_mix(h, quantize((double)p.dx, quantum));
+		h = hash_mix(h, quantize((double)p.dy, quantum));
+		h = hash_mix(h, state.djump, state.held);
+		h = hash_mix(h, (uint64_t)snap.grav_dir);
+		for (size_t m = 0; m < snap.solids.size(); m++)
+		{
+			const Hitbox& s = snap.solids[m];
+			h = hash_mix(hash_mix(h, s.x, s.y), s.dx, s.dy);
+		}
+		for (size_t m = 0; m < snap.segments.size(); m++)
+		{
+			const Segment& s = snap.segments[m];
+			h = hash_mix(hash_mix(h, s.x, s.y), s.dx, s.dy);
+		}
+		return h;
+	}
+
+	// pixels between the player and the goal
+	static double distance(const BBox& player, const Hitbox& goal)
+	{
+		double gx = std::max(std::max((double)(left(goal) - right(player)), (double)(left(player) - right(goal))), 0.0);
+		double gy = std::max(std::max((double)(top(goal) - bottom(player)), (double)(top(player) - bottom(goal))), 0.0);
+		return sqrt(gx * gx + gy * gy);
+	}
+
+	// keeps the beam states closest to the goal. closest alone would crowd every state
+	// against the first wall in the way, so only a few are taken from each spot at first
+	static void prune(std::vector<Open>& states, const SearchParams& params, size_t player)
+	{
+		std::stable_sort(states.begin(), states.end(),
+			[](const Open& a, const Open& b) { return a.distance < b.distance; });
+		size_t per_spot = std::max(params.beam / params.spots, (size_t)1);
+		std::unordered_map<uint64_t, size_t> taken;
+		std::vector<Open> kept, rest;
+		for (size_t i = 0; i < states.size(); i++)
+		{
+			const BBox& p = states[i].snap.collidables[player];
+			uint64_t spot = ((uint64_t)(uint32_t)(int)floor((double)p.x / params.spot_size) << 32) | (uint32_t)(int)floor((double)p.y / params.spot_size);
+			if (kept.size() < params.beam && taken[spot]++ < per_spot)
+				kept.push_back(std::move(states[i]));
+			else
+				rest.push_back(std::move(states[i]));
+		}
+		// room left goes to the closest of the rest
+		for (size_t i = 0; i < rest.size() && kept.size() < params.beam; i++)
+			kept.push_back(std::move(rest[i]));
+		states.swap(kept);
+	}
+
+	static void route(SearchResult& result, const std::vector<Node>& nodes, unsigned int node)
+	{
+		result.found = true;
+		for (; nodes[node].parent != NO_PARENT; node = nodes[node].parent)
+			result.inputs.push_back(nodes[node].input);
+		std::reverse(result.inputs.begin(), result.inputs.end());
+	}
+
+	SearchResult search_inputs(
+		int grav_dir,
+		const Hitbox* solids, size_t solidsC,
+		const Segment* segments, size_t segmentsC,
+		const BBox* collidables, size_t collidablesC,
+		const SearchParams& params
+	) {
+		SearchResult result;
+		size_t player = params.player;
+		if (player >= collidablesC) return result;
+		unsigned int threads = params.threads ? params.threads : std::thread::hardware_concurrency();
+		if (threads == 0) threads = 1;
+		// a scene for every thread, states move between them as snapshots
+		SceneBatch batch(grav_dir, solids, solidsC, segments, segmentsC, collidables, collidablesC, threads, threads);
+
+		std::vector<Node> nodes;
+		std::unordered_set<uint64_t> seen;
+		std::vector<Open> frontier(1), children, next;
+		Open& root = frontier[0];
+		root.node = 0;
+		root.djump = params.djump;
+		root.held = params.jump_held;
+		root.valid = true;
+		batch.scene(0).save(root.snap);
+		root.distance = distance(collidables[player], params.goal);
+		root.hash = state_hash(root, player, params.quantum);
+		nodes.push_back({ NO_PARENT, { 0, false, false } });
+		seen.insert(root.hash);
+		if (intersect(get_hitbox(collidables[player]), params.goal))
+		{
+			route(result, nodes, 0);
+			return result;
+		}
+
+		for (unsigned int frame = 0; frame < params.max_frames && !frontier.empty(); frame++)
+		{
+			// every state of the frame tries every input, in parallel
+			children.resize(frontier.size() * choicesC);
+			batch.pool().run(frontier.size(), [&](size_t i, unsigned int w)
+			{
+				SolidScene& scene = batch.scene(w);
+				BBox& p = batch.collidables(w)[player];
+				const Open& state = frontier[i];
+				for (size_t k = 0; k < choicesC; k++)
+				{
+					const PlayerInput& input = choices[k];
+					Open& child = children[i * choicesC + k];
+					child.valid = false;
+					if ((input.jump_pressed && state.held) || (input.jump_released && !state.held))
+						continue;
+					scene.restore(state.snap);
+					child.djump = state.djump;
+					// snapshots carry contacts, so the ground can be known without a projection
+					control_player(scene.grav_dir, standing(scene, player), p, child.djump, input);
+					scene.update();
+					if (!scene.alive[player]) continue;
+					child.valid = true;
+					child.held = input.jump_pressed || (state.held && !input.jump_released);
+					child.distance = distance(p, params.goal);
+					scene.save(child.snap);
+					child.hash = state_hash(child, player, params.quantum);
+				}
+			});
+
+			// then new states are picked in order, so the result doesn't depend on threads
+			next.clear();
+			for (size_t j = 0; j < children.size(); j++)
+			{
+				const PlayerInput& input = choices[j % choicesC];
+				const Open& parent = frontier[j / choicesC];
+				if (!(input.jump_pressed && parent.held) && !(input.jump_released && !parent.held))
+					result.states++;
+				Open& child = children[j];
+				if (!child.valid) continue;
+				if (!seen.insert(child.hash).second)
+				{
+					result.duplicates++;
+					continue;
+				}
+				child.node = (unsigned int)nodes.size();
+				nodes.push_back({ parent.node, input });
+				if (child.distance == 0.0 && intersect(get_hitbox(child.snap.collidables[player]), params.goal))
+				{
+					route(result, nodes, child.node);
+					return result;
+				}
+				next.push_back(std::move(child));
+			}
+			if (params.beam && next.size() > params.beam)
+				prune(next, params, player);
+			std::swap(frontier, next);
+			if (result.states >= params.max_states) break;
+		}
+		return result;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "hitbox.h"
+#include "player.h"
+
+namespace iwemu
+{
+	struct SearchParams
+	{
+		// the player has to touch it alive
+		Hitbox goal = { 0, 0, 0, 0, 0, 0 };
+		// which collidable is the player. other collidables get no input
+		size_t player = 0;
+		int djump = maxDJump;
+		// is jump held at the start
+		bool jump_held = false;
+		unsigned int max_frames = 300;
+		// stop after that many states were simulated
+		size_t max_states = 10000000;
+		// 0 - breadth first, every new state is kept, so the route found is the shortest one.
+		// otherwise only beam states closest to the goal are kept after every frame
+		size_t beam = 0;
+		// beam is spread over spots of spot_size pixels, at most beam / spots states from each
+		size_t spots = 32;
+		double spot_size = 8.0;
+		// player positions and speeds are rounded to this before states are compared.
+		// routes found are exact anyway, coarser only means some of them can be missed
+		double quantum = 0.5;
+		// 0 - all cores
+		unsigned int threads = 0;
+	};
+
+	struct SearchResult
+	{
+		bool found = false;
+		// input of every frame, from the first one
+		std::vector<PlayerInput> inputs;
+		// update() calls done
+		size_t states = 0;
+		// states that turned out to be the same as one seen before
+		size_t duplicates = 0;
+	};
+
+	// looks for inputs that take the player into the goal, trying every input on every frame:
+	// left, right or nothing, with jump pressed, released or left as it is.
+	// copies of the room are made, one per thread
+	SearchResult search_inputs(
+		int grav_dir,
+		const Hitbox* solids, size_t solidsC,
+		const Segment* segments, size_t segmentsC,
+		const BBox* collidables, size_t collidablesC,
+		const SearchParams& params
+	);
+}
@@ -1,22 +1,27 @@
 #include "solids.h"
 
 #include <math.h>
+#include <algorithm>
+#include "bits.h"
+#include "hash.h"
 
 namespace iwemu
 {
-	inline bool intersectF(double s1, unsigned int l1, double s2, unsigned int l2)
+	template <typename T>
+	inline bool intersectF(T s1, unsigned int l1, T s2, unsigned int l2)
 	{
-		return (s2 < s1 + (double)l1) && (s1 < s2 + (double)l2);
+		return (s2 < s1 + T(l1)) && (s1 < s2 + T(l2));
 	}
 
+	template <typename T>
 	bool dyn_seg_h(
-		double x1, double y1, unsigned int l1,
+		T x1, T y1, unsigned int l1,
 		int x2, int y2, unsigned int l2,
 		int dx2, int dy2
 	) {
 		if (dy2)
 		{
-			double k = (y1 - y2) / dy2;
+			T k = (y1 - y2) / dy2;
 			if (k >= 0 && k <= 1 && intersectF(x1, l1, x2 + k * dx2, l2))
 			{
 				return true;
@@ -25,14 +30,15 @@ namespace iwemu
 		return false;
 	}
 
+	template <typename T>
 	bool dyn_seg_v(
-		double x1, double y1, unsigned int l1,
+		T x1, T y1, unsigned int l1,
 		int x2, int y2, unsigned int l2,
 		int dx2, int dy2
 	) {
 		if (dx2)
 		{
-			double k = (x1 - x2) / dx2;
+			T k = (x1 - x2) / dx2;
 			if (k >= 0 && k <= 1 && intersectF(y1, l1, y2 + k * dy2, l2))
 			{
 				return true;
@@ -41,98 +47,1249 @@ namespace iwemu
 		return false;
 	}
 
+	// everything a moving solid can touch this frame: where it is, where it goes,
+	// and a pixel around for those who stand on it. collidables outside of it can be skipped
+	inline Hitbox reach(int x, int y, unsigned int width, unsigned int height, int dx, int dy)
+	{
+		return {
+			(dx < 0 ? x + dx : x) - 1, (dy < 0 ? y + dy : y) - 1,
+			width + abs(dx) + 2, height + abs(dy) + 2,
+			dx, dy
+		};
+	}
+
+	inline Hitbox reach(const Hitbox& hbox)
+	{
+		return reach(hbox.x, hbox.y, hbox.width, hbox.height, hbox.dx, hbox.dy);
+	}
+
+	inline Hitbox reach(const Segment& seg)
+	{
+		if (seg.vertical)
+			return reach(seg.x, seg.y, 1, seg.length, seg.dx, seg.dy);
+		else
+			return reach(seg.x, seg.y, seg.length, 1, seg.dx, seg.dy);
+	}
+
+	SolidScene::SolidScene(
+		int grav_dir,
+		Hitbox* solids, size_t solidsC,
+		Segment* segments, size_t segmentsC,
+		BBox* collidables, size_t collidablesC,
+		size_t liveC
+	) : grav_dir(grav_dir), _solids(solids), _solidsC(solidsC),
+		_segments(segments), _segmentsC(segmentsC),
+		_collidable(collidables), _collidableC(std::min(liveC, collidablesC)), _collidableCapacity(collidablesC)
+	{
+		this->init();
+		this->reindex();
+	}
+
 	SolidScene::SolidScene(
+		const SolidScene& shared,
 		int grav_dir,
 		Hitbox* solids, size_t solidsC,
 		Segment* segments, size_t segmentsC,
-		BBox* collidables, size_t collidablesC
+		BBox* collidables, size_t collidablesC,
+		size_t liveC
 	) : grav_dir(grav_dir), _solids(solids), _solidsC(solidsC),
 		_segments(segments), _segmentsC(segmentsC),
-		_collidable(collidables), _collidableC(collidablesC)
+		_collidable(collidables), _collidableC(std::min(liveC, collidablesC)), _collidableCapacity(collidablesC)
+	{
+		this->init();
+		this->_tiles = shared._tiles;
+		this->_grid.build(shared._grid, solids, solidsC, segments, segmentsC);
+		this->find_movers();
+		this->refresh_contacts();
+	}
+
+	SolidScene::SolidScene(
+		const Level& level,
+		int grav_dir,
+		BBox* collidables, size_t collidablesC,
+		size_t liveC
+	) : grav_dir(grav_dir), _solids(level.solids), _solidsC(level.solidsC),
+		_segments(level.segments), _segmentsC(level.segmentsC),
+		_collidable(collidables), _collidableC(std::min(liveC, collidablesC)), _collidableCapacity(collidablesC)
+	{
+		this->init();
+		this->_grid.build(level.grid, level.solids, level.solidsC, level.segments, level.segmentsC);
+		this->find_movers();
+		this->refresh_contacts();
+	}
+
+	SolidScene::SolidScene(
+		World& world,
+		int grav_dir,
+		BBox* collidables, size_t collidablesC,
+		size_t liveC
+	) : grav_dir(grav_dir), _collidable(collidables), _collidableC(std::min(liveC, collidablesC)),
+		_collidableCapacity(collidablesC), _world(&world)
+	{
+		this->init();
+		this->_solids = world.solids();
+		this->_solidsC = world.solids_count();
+		this->_segments = world.segments();
+		this->_segmentsC = world.segments_count();
+		this->find_movers();
+		if (!this->stream()) this->reindex();
+	}
+
+	void SolidScene::init()
 	{
-		this->alive = new bool[collidablesC];
-		for (size_t i = 0; i < collidablesC; i++)
+		// everything a collidable has is made for the whole slab at once, so spawning allocates nothing
+		size_t capacity = this->_collidableCapacity;
+		this->alive = new bool[capacity];
+		for (size_t i = 0; i < capacity; i++)
 			this->alive[i] = true;
-		this->_collidableOld = new BBox[collidablesC];
+		this->_collidableOld = new BBox[capacity];
+		this->_collidable_reach.resize(capacity);
+		this->_standing.resize(capacity);
+		this->_contacts.resize(capacity);
+		this->_slots.resize(capacity);
+		this->_slot_index.resize(capacity);
+		this->_generations.assign(capacity, 0);
+		for (size_t i = 0; i < capacity; i++)
+		{
+			this->_all_collidables.push_back((unsigned int)i);
+			this->_slots[i] = (unsigned int)i;
+			this->_slot_index[i] = (unsigned int)i;
+		}
 	}
 
 	SolidScene::~SolidScene()
 	{
-		delete this->alive;
-		delete this->_collidableOld;
+		delete[] this->alive;
+		delete[] this->_collidableOld;
 	}
 
-	bool SolidScene::place_solid(const Hitbox& hbox)
+	void SolidScene::reindex()
+	{
+		if (this->_world)
+			this->index_chunks();
+		else
+			this->_grid.build(this->_solids, this->_solidsC, this->_segments, this->_segmentsC);
+		this->find_movers();
+		this->refresh_contacts();
+	}
+
+	void SolidScene::index_chunks()
+	{
+		// the grid is over the indexed chunks only, movers far from them are in its border cells
+		const World& world = *this->_world;
+		const World::ChunkRange& r = world.indexed_range();
+		int size = world.chunk_size();
+		this->_grid.build(world.x() + r.col1 * size, world.y() + r.row1 * size, size / this->_grid.cell_size(),
+			r.col2 - r.col1 + 1, r.row2 - r.row1 + 1, this->_solids, this->_solidsC, this->_segments, this->_segmentsC);
+		this->_chunks = r;
+		for (unsigned int c : world.indexed())
+			this->set_chunk(c);
+	}
+
+	void SolidScene::set_chunk(unsigned int c)
 	{
+		const World& world = *this->_world;
+		int col = (int)(c % world.cols()) - this->_chunks.col1, row = (int)(c / world.cols()) - this->_chunks.row1;
+		const Level* level = world.level(c);
+		if (level)
+			this->_grid.set_block(col, row, &level->grid.static_arrays(), level->file, level->solids, level->segments);
+		else
+			this->_grid.set_block(col, row, 0, 0, 0, 0);
+	}
+
+	bool SolidScene::stream()
+	{
+		if (!this->_world) return false;
+		std::vector<Hitbox>& areas = this->_stream_areas;
+		areas.clear();
+		for (size_t k = 0; k < this->_collidableC; k++)
+			if (this->alive[k]) areas.push_back(get_hitbox(this->_collidable[k]));
+		const ProjectileArrays& p = this->_projectiles;
+		for (size_t i = 0; i < p.tag.size(); i++)
+			areas.push_back({ (int)pixel(p.x[i]), (int)pixel(p.y[i]), p.width[i], p.height[i], 0, 0 });
+#ifdef IWEMU_STATS
+		size_t reads = this->_world->reads();
+#endif
+		if (!this->_world->select(areas.data(), areas.size())) return false;
+		IWEMU_COUNT_N(chunk_reads, this->_world->reads() - reads);
+		// the grid is only made again when it has to be bigger or smaller, chunks that came or went are
+		// put in or taken out of it as they are otherwise
+		const World::ChunkRange& r = this->_world->indexed_range();
+		const World::ChunkRange& was = this->_chunks;
+		if (r.col1 != was.col1 || r.row1 != was.row1 || r.col2 != was.col2 || r.row2 != was.row2)
+			this->index_chunks();
+		else
+			for (unsigned int c : this->_world->changed())
+				this->set_chunk(c);
+		this->_projectile_hits.clear();
+		this->refresh_contacts();
+		return true;
+	}
+
+	void SolidScene::set_tiles(const TileLayer* tiles)
+	{
+		this->_tiles = tiles;
+		this->refresh_contacts();
+	}
+
+	void SolidScene::find_movers()
+	{
+		this->_moving_solids.clear();
 		for (size_t i = 0; i < this->_solidsC; i++)
+			if (moving(this->_solids[i])) this->_moving_solids.push_back((unsigned int)i);
+		this->_moving_segments.clear();
+		for (size_t i = 0; i < this->_segmentsC; i++)
+			if (moving(this->_segments[i])) this->_moving_segments.push_back((unsigned int)i);
+		this->_done.resize(this->_moving_solids.size() + this->_moving_segments.size());
+		this->_broadphase.reserve(this->_done.size(), this->_collidableCapacity);
+		this->hash_movers();
+	}
+
+	// hash of mover m at (x, y). movers are added up, so one that moves only changes its own part of the sum.
+	// m counts moving solids, then moving segments
+	static inline uint64_t mover_hash(size_t m, int x, int y)
+	{
+		return hash_mix(hash_mix(HASH_SEED, (uint64_t)m), x, y);
+	}
+
+	void SolidScene::hash_movers()
+	{
+		uint64_t h = 0;
+		for (size_t m = 0; m < this->_moving_solids.size(); m++)
+		{
+			const Hitbox& s = this->_solids[this->_moving_solids[m]];
+			h += mover_hash(m, s.x, s.y);
+		}
+		for (size_t m = 0; m < this->_moving_segments.size(); m++)
+		{
+			const Segment& s = this->_segments[this->_moving_segments[m]];
+			h += mover_hash(this->_moving_solids.size() + m, s.x, s.y);
+		}
+		this->_movers_hash = h;
+	}
+
+	void SolidScene::save(Snapshot& dest) const
+	{
+		dest.solids.resize(this->_moving_solids.size());
+		for (size_t m = 0; m < this->_moving_solids.size(); m++)
+			dest.solids[m] = this->_solids[this->_moving_solids[m]];
+		dest.segments.resize(this->_moving_segments.size());
+		for (size_t m = 0; m < this->_moving_segments.size(); m++)
+			dest.segments[m] = this->_segments[this->_moving_segments[m]];
+		dest.collidables.assign(this->_collidable, this->_collidable + this->_collidableC);
+		dest.alive.assign(this->alive, this->alive + this->_collidableC);
+		dest.contacts.assign(this->_contacts.begin(), this->_contacts.begin() + this->_collidableC);
+		dest.slots.assign(this->_slots.begin(), this->_slots.end());
+		dest.generations.assign(this->_generations.begin(), this->_generations.end());
+		dest.projectiles = this->_projectiles;
+		dest.grav_dir = this->grav_dir;
+		dest.generation = this->_grid.generation();
+		dest.solids_base = this->_solids;
+		dest.segments_base = this->_segments;
+		dest.solidsC = this->_solidsC;
+		dest.segmentsC = this->_segmentsC;
+	}
+
+	// moves p from the array at base into the one at to, false if it points to something else.
+	// addresses are compared as numbers, since comparing pointers into different arrays is undefined
+	template <typename T>
+	static bool move_pointer(T*& p, const T* base, size_t count, T* to)
+	{
+		if (!p) return true;
+		uintptr_t a = (uintptr_t)p, b = (uintptr_t)base;
+		if (a < b || a >= b + count * sizeof(T)) return false;
+		p = to + (a - b) / sizeof(T);
+		return true;
+	}
+
+	bool SolidScene::restore(const Snapshot& snap)
+	{
+		if (snap.generation != this->_grid.generation() ||
+			snap.solids.size() != this->_moving_solids.size() ||
+			snap.segments.size() != this->_moving_segments.size() ||
+			snap.slots.size() != this->_collidableCapacity)
+			return false;
+		// movers go back through the grid, so they end up in the right cells
+		for (size_t m = 0; m < this->_moving_solids.size(); m++)
+		{
+			unsigned int i = this->_moving_solids[m];
+			this->_solids[i] = snap.solids[m];
+			this->_grid.move_solid(i, this->_solids[i]);
+		}
+		for (size_t m = 0; m < this->_moving_segments.size(); m++)
+		{
+			unsigned int i = this->_moving_segments[m];
+			this->_segments[i] = snap.segments[m];
+			this->_grid.move_segment(i, this->_segments[i]);
+		}
+		this->hash_movers();
+		this->_collidableC = snap.collidables.size();
+		std::copy(snap.collidables.begin(), snap.collidables.end(), this->_collidable);
+		std::copy(snap.alive.begin(), snap.alive.end(), this->alive);
+		std::copy(snap.slots.begin(), snap.slots.end(), this->_slots.begin());
+		std::copy(snap.generations.begin(), snap.generations.end(), this->_generations.begin());
+		for (size_t i = 0; i < this->_collidableCapacity; i++)
+			this->_slot_index[this->_slots[i]] = (unsigned int)i;
+		this->_projectiles = snap.projectiles;
+		// contacts point into the solids and segments of the scene that saved them
+		for (size_t k = 0; k < this->_collidableC; k++)
+		{
+			Contact& c = this->_contacts[k];
+			c = snap.contacts[k];
+			for (int side = 0; side < 4; side++)
+			{
+				Side& found = c.sides[side];
+				if (!move_pointer(found.solid, snap.solids_base, snap.solidsC, this->_solids) ||
+					!move_pointer(found.segment, snap.segments_base, snap.segmentsC, this->_segments))
+				{
+					c.known &= ~(1u << side);
+					found.solid = 0;
+					found.segment = 0;
+				}
+			}
+			if (!move_pointer(c.carried_by_solid, snap.solids_base, snap.solidsC, this->_solids))
+				c.carried_by_solid = 0;
+			if (!move_pointer(c.carried_by_segment, snap.segments_base, snap.segmentsC, this->_segments))
+				c.carried_by_segment = 0;
+		}
+		this->grav_dir = snap.grav_dir;
+		// the chunks are the ones it was saved with, picked again around where collidables are now, like update() does
+		this->stream();
+		return true;
+	}
+
+	SolidScene::Handle SolidScene::spawn(const BBox& bbox)
+	{
+		if (this->_collidableC == this->_collidableCapacity)
+			return { ~0u, 0 };
+		size_t k = this->_collidableC++;
+		this->_collidable[k] = bbox;
+		this->alive[k] = true;
+		Contact& c = this->_contacts[k];
+		c.known = 0;
+		c.carried_by_solid = 0;
+		c.carried_by_segment = 0;
+		c.death = Death::NONE;
+		return this->handle_of(k);
+	}
+
+	bool SolidScene::despawn(Handle handle)
+	{
+		long k = this->index_of(handle);
+		if (k < 0) return false;
+		this->despawn_at((size_t)k);
+		return true;
+	}
+
+	void SolidScene::despawn_at(size_t k)
+	{
+		// the last one fills the hole, and the slot goes past the end, where free ones are
+		size_t last = --this->_collidableC;
+		unsigned int slot = this->_slots[k];
+		this->_generations[slot]++;
+		if (k == last) return;
+		this->_collidable[k] = this->_collidable[last];
+		this->alive[k] = this->alive[last];
+		this->_contacts[k] = this->_contacts[last];
+		this->_slots[k] = this->_slots[last];
+		this->_slots[last] = slot;
+		this->_slot_index[this->_slots[k]] = (unsigned int)k;
+		this->_slot_index[slot] = (unsigned int)last;
+	}
+
+	size_t SolidScene::compact()
+	{
+		// from the end, so the one that fills a hole is always alive
+		size_t was = this->_collidableC;
+		for (size_t k = was; k > 0; k--)
+			if (!this->alive[k - 1]) this->despawn_at(k - 1);
+		return was - this->_collidableC;
+	}
+
+	long SolidScene::index_of(Handle handle) const
+	{
+		if (handle.slot >= this->_collidableCapacity || this->_generations[handle.slot] != handle.generation)
+			return -1;
+		unsigned int k = this->_slot_index[handle.slot];
+		return k < this->_collidableC ? (long)k : -1;
+	}
+
+	SolidScene::Handle SolidScene::handle_of(size_t k) const
+	{
+		unsigned int slot = this->_slots[k];
+		return { slot, this->_generations[slot] };
+	}
+
+	void SolidScene::add_projectile(const BBox& bbox, unsigned int tag)
+	{
+		ProjectileArrays& p = this->_projectiles;
+		p.x.push_back(bbox.x);
+		p.y.push_back(bbox.y);
+		p.dx.push_back(bbox.dx);
+		p.dy.push_back(bbox.dy);
+		p.width.push_back(bbox.width);
+		p.height.push_back(bbox.height);
+		p.tag.push_back(tag);
+	}
+
+	// moves element i of an array to the end, and drops it
+	template <typename T>
+	static void swap_remove(std::vector<T>& v, size_t i)
+	{
+		v[i] = v.back();
+		v.pop_back();
+	}
+
+	void SolidScene::remove_projectile(size_t i)
+	{
+		ProjectileArrays& p = this->_projectiles;
+		swap_remove(p.x, i);
+		swap_remove(p.y, i);
+		swap_remove(p.dx, i);
+		swap_remove(p.dy, i);
+		swap_remove(p.width, i);
+		swap_remove(p.height, i);
+		swap_remove(p.tag, i);
+	}
+
+	uint64_t SolidScene::state_hash() const
+	{
+		uint64_t h = hash_mix(hash_mix(HASH_SEED, (uint64_t)this->grav_dir), this->_movers_hash);
+		for (size_t k = 0; k < this->_collidableC; k++)
+		{
+			const BBox& c = this->_collidable[k];
+			h = hash_mix(hash_mix(h, c.x), c.y);
+			h = hash_mix(hash_mix(h, c.dx), c.dy);
+			h = hash_mix(h, (int)c.width, (int)c.height);
+			h = hash_mix(h, (uint64_t)this->alive[k]);
+		}
+		const ProjectileArrays& p = this->_projectiles;
+		for (size_t i = 0; i < p.tag.size(); i++)
+		{
+			h = hash_mix(hash_mix(h, p.x[i]), p.y[i]);
+			h = hash_mix(hash_mix(h, p.dx[i]), p.dy[i]);
+			h = hash_mix(hash_mix(h, (int)p.width[i], (int)p.height[i]), (uint64_t)p.tag[i]);
+		}
+		return h;
+	}
+
+	void SolidScene::move_solid(size_t m, int dx, int dy)
+	{
+		unsigned int i = this->_moving_solids[m];
+		Hitbox& cs = this->_solids[i];
+		this->_movers_hash -= mover_hash(m, cs.x, cs.y);
+		cs.x += dx;
+		cs.y += dy;
+		this->_movers_hash += mover_hash(m, cs.x, cs.y);
+		this->_grid.move_solid(i, cs);
+	}
+
+	void SolidScene::move_segment(size_t m, int dx, int dy)
+	{
+		unsigned int i = this->_moving_segments[m];
+		Segment& cs = this->_segments[i];
+		size_t n = this->_moving_solids.size() + m;
+		this->_movers_hash -= mover_hash(n, cs.x, cs.y);
+		cs.x += dx;
+		cs.y += dy;
+		this->_movers_hash += mover_hash(n, cs.x, cs.y);
+		this->_grid.move_segment(i, cs);
+	}
+
+	bool SolidScene::solid_in(const SolidGrid::Cell& cell, const Hitbox& hbox)
+	{
+		if (cell.merged_solids)
+		{	// a box of zero size can fall between the parts of a merged solid, only they can tell then
+			const MergedSolids& m = *cell.merged_solids;
+			bool parts = thin(hbox);
+			if (!parts && cell.solidsC >= SIMD_MIN)
+			{	// a crowded static cell, its boxes are tested a bunch at a time
+				IWEMU_COUNT_N(intersects, cell.solidsC);
+				return first_intersect(cell.boxes, cell.solidsC, hbox) != NOT_FOUND;
+			}
+			for (size_t i = 0; i < cell.solidsC; i++)
+			{
+				size_t k = cell.solids[i];
+				IWEMU_COUNT(intersects);
+				if (intersect(hbox, m.boxes[k]) &&
+					(!parts || m.parts_of(k) == 1 || intersect_parts(m, k, cell.solid_array, hbox)))
+					return true;
+			}
+			return false;
+		}
+		for (size_t i = 0; i < cell.solidsC; i++)
+		{
+			IWEMU_COUNT(intersects);
+			if (intersect(hbox, cell.solid_array[cell.solids[i]]))
+				return true;
+		}
+		return false;
+	}
+
+	bool SolidScene::segment_in(const SolidGrid::Cell& cell, const Hitbox& hbox)
+	{
+		if (cell.merged_segments)
 		{
-			if (intersect(hbox, this->_solids[i]))
+			const MergedSegments& m = *cell.merged_segments;
+			bool parts = thin(hbox);
+			for (size_t i = 0; i < cell.segmentsC; i++)
+			{
+				size_t k = cell.segments[i];
+				IWEMU_COUNT(intersects);
+				if (intersect(hbox, m.segments[k]) &&
+					(!parts || m.parts_of(k) == 1 || intersect_parts(m, k, cell.segment_array, hbox)))
+					return true;
+			}
+			return false;
+		}
+		for (size_t i = 0; i < cell.segmentsC; i++)
+		{
+			IWEMU_COUNT(intersects);
+			if (intersect(hbox, cell.segment_array[cell.segments[i]]))
 				return true;
 		}
 		return false;
 	}
 
+	bool SolidScene::place_solid(const Hitbox& hbox)
+	{
+		IWEMU_COUNT(place_solids);
+		if (this->_tiles && this->_tiles->intersects(hbox))
+			return true;
+		// only the cells that hbox touches can have something intersecting it
+		SolidGrid::CellRange r = this->_grid.range(hbox);
+		for (int row = r.row1; row <= r.row2; row++)
+		{
+			for (int col = r.col1; col <= r.col2; col++)
+			{
+				if (this->solid_in(this->_grid.static_cell(col, row), hbox) ||
+					this->solid_in(this->_grid.moving_cell(col, row), hbox))
+					return true;
+			}
+		}
+		return false;
+	}
+
 	bool SolidScene::place_free(const Hitbox& hbox)
 	{
+		IWEMU_COUNT(place_frees);
 		if (place_solid(hbox)) return false;
-		for (size_t i = 0; i < this->_segmentsC; i++)
+		SolidGrid::CellRange r = this->_grid.range(hbox);
+		for (int row = r.row1; row <= r.row2; row++)
 		{
-			if (intersect(hbox, this->_segments[i]))
-				return false;
+			for (int col = r.col1; col <= r.col2; col++)
+			{
+				if (this->segment_in(this->_grid.static_cell(col, row), hbox) ||
+					this->segment_in(this->_grid.moving_cell(col, row), hbox))
+					return false;
+			}
 		}
 		return true;
 	}
 
+	// counters of the bins of a batch query take 16kb at most
+	static const size_t MAX_BATCH_BINS = 4096;
+
+	void SolidScene::sort_batch(const Hitbox* hboxes, size_t hboxesC)
+	{
+		// boxes go into square bins of cells by counting sort. bins are made bigger until
+		// there are no more of them than boxes, and their counters stay in the cache
+		int shift = 0;
+		size_t bin_cols, binsC;
+		for (;; shift++)
+		{
+			bin_cols = (size_t)((this->_grid.cols() - 1) >> shift) + 1;
+			binsC = bin_cols * (((this->_grid.rows() - 1) >> shift) + 1);
+			if (binsC <= std::min(std::max(hboxesC, (size_t)64), MAX_BATCH_BINS)) break;
+		}
+		this->_batch_bin.resize(hboxesC);
+		this->_batch_offsets.assign(binsC + 1, 0);
+		for (size_t i = 0; i < hboxesC; i++)
+		{
+			// the cell of the top-left corner is enough to tell where a box is
+			int col = this->_grid.col_of(hboxes[i].x), row = this->_grid.row_of(hboxes[i].y);
+			unsigned int bin = (unsigned int)((row >> shift) * bin_cols + (col >> shift));
+			this->_batch_bin[i] = bin;
+			this->_batch_offsets[bin + 1]++;
+		}
+		for (size_t b = 0; b < binsC; b++)
+			this->_batch_offsets[b + 1] += this->_batch_offsets[b];
+		// boxes are copied, so the queries read them one after another
+		this->_batch_boxes.resize(hboxesC);
+		this->_batch_order.resize(hboxesC);
+		for (size_t i = 0; i < hboxesC; i++)
+		{
+			unsigned int k = this->_batch_offsets[this->_batch_bin[i]]++;
+			this->_batch_boxes[k] = hboxes[i];
+			this->_batch_order[k] = (unsigned int)i;
+		}
+	}
 
-	double SolidScene::project_free_direction(const BBox& bbox, Hitbox** hbox_p_dest, Segment** seg_p_dest, 
-		double (*project_function_hbox)(const BBox&, const Hitbox&), 
-		double (*project_function_seg)(const BBox&, const Segment&))
+	void SolidScene::place_solid(const Hitbox* hboxes, size_t hboxesC, uint64_t* dest)
 	{
-		double dist = INFINITY, cdist;
+		std::fill(dest, dest + (hboxesC + 63) / 64, 0);
+		this->sort_batch(hboxes, hboxesC);
+		for (size_t k = 0; k < hboxesC; k++)
+		{
+			size_t i = this->_batch_order[k];
+			if (this->place_solid(this->_batch_boxes[k]))
+				dest[i / 64] |= (uint64_t)1 << (i % 64);
+		}
+	}
+
+	bool SolidScene::free_at(const Hitbox& hbox)
+	{
+		IWEMU_COUNT(place_frees);
+		if (this->_tiles && this->_tiles->intersects(hbox))
+			return false;
+		SolidGrid::CellRange r = this->_grid.range(hbox);
+		for (int row = r.row1; row <= r.row2; row++)
+		{
+			for (int col = r.col1; col <= r.col2; col++)
+			{
+				SolidGrid::Cell s = this->_grid.static_cell(col, row), m = this->_grid.moving_cell(col, row);
+				if (this->solid_in(s, hbox) || this->solid_in(m, hbox) ||
+					this->segment_in(s, hbox) || this->segment_in(m, hbox))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	void SolidScene::place_free(const Hitbox* hboxes, size_t hboxesC, uint64_t* dest)
+	{
+		std::fill(dest, dest + (hboxesC + 63) / 64, 0);
+		this->sort_batch(hboxes, hboxesC);
+		for (size_t k = 0; k < hboxesC; k++)
+		{
+			size_t i = this->_batch_order[k];
+			if (this->free_at(this->_batch_boxes[k]))
+				dest[i / 64] |= (uint64_t)1 << (i % 64);
+		}
+	}
+
+	// is a part of merged solid k under a box
+	static bool standing_on_part(const MergedSolids& merged, size_t k, const Hitbox* solids, const Hitbox& below, const Hitbox& current)
+	{
+		for (unsigned int p = merged.offsets[k]; p < merged.offsets[k + 1]; p++)
+		{
+			const Hitbox& cs = solids[merged.parts[p]];
+			if (intersect(below, cs) && !intersect(current, cs))
+				return true;
+		}
+		return false;
+	}
+
+	bool SolidScene::standing_on_static(const BBox& bbox)
+	{
+		Hitbox below = get_hitbox(rel(bbox, 0, this->grav_dir));
+		Hitbox current = get_hitbox(bbox);
+		if (this->_tiles && this->_tiles->intersects_except(below, current))
+			return true;
+		SolidGrid::CellRange r = this->_grid.range(below);
+		for (int row = r.row1; row <= r.row2; row++)
+		{
+			for (int col = r.col1; col <= r.col2; col++)
+			{
+				SolidGrid::Cell cell = this->_grid.static_cell(col, row);
+				const MergedSolids& m = *cell.merged_solids;
+				for (size_t i = 0; i < cell.solidsC; i++)
+				{
+					size_t k = cell.solids[i];
+					IWEMU_COUNT(intersects);
+					if (!intersect(below, m.boxes[k]))
+						continue;
+					if (m.parts_of(k) == 1)
+					{
+						if (!intersect(current, m.boxes[k]))
+							return true;
+					}
+					// if bbox is inside of a merged solid, or has no size, a part of it can still be under bbox
+					else if ((!thin(below) && !intersect(current, m.boxes[k])) ||
+						standing_on_part(m, k, cell.solid_array, below, current))
+						return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	// coordinates the kernels can take: the limits of nearest_boxes() have to fit in an int
+	inline bool kernel_range(Scalar v)
+	{
+		return v > -(1 << 30) && v < (1 << 30);
+	}
+
+	// the closest of the parts of a merged object, and the first one of those at that distance
+	template <typename T, Scalar (*project_function)(const BBox&, const T&)>
+	inline Scalar closest_part(const unsigned int* parts, size_t partsC, T* objects, const BBox& bbox, T*& found)
+	{
+		Scalar dist = infinity<Scalar>();
+		found = 0;
+		for (size_t p = 0; p < partsC; p++)
+		{
+			T* part = objects + parts[p];
+			Scalar d = project_function(bbox, *part);
+			if (d < dist || (d == dist && (!found || part < found)))
+			{
+				dist = d;
+				found = part;
+			}
+		}
+		return dist;
+	}
+
+	// lowest index of the parts on the side of merged solid k that faces a box, and are in the way of it.
+	// if the box is outside of the merged solid, these are the closest parts, all at the distance of the whole
+	template <bool horizontal, int step>
+	inline size_t facing_part(const MergedSolids& merged, size_t k, const Hitbox& hbox)
+	{
+		const Hitbox& cs = merged.boxes[k];
+		const unsigned int* parts = merged.parts + merged.offsets[k];
+		int64_t cols = merged.cols[k], rows = (int64_t)merged.parts_of(k) / cols;
+		// parts are in a line across the direction, the box spans some of them
+		int64_t size = horizontal ? cs.height / rows : cs.width / cols;
+		int64_t from = horizontal ? (int64_t)hbox.y - cs.y : (int64_t)hbox.x - cs.x;
+		int64_t length = horizontal ? hbox.height : hbox.width;
+		int64_t first = std::max(floor_div(from, size), (int64_t)0);
+		int64_t last = std::min(floor_div(from + length - 1, size), (horizontal ? rows : cols) - 1);
+		int64_t line = step < 0 ? (horizontal ? cols : rows) - 1 : 0;
+		size_t index = (size_t)-1;
+		for (int64_t t = first; t <= last; t++)
+			index = std::min(index, (size_t)(horizontal ? parts[t * cols + line] : parts[line * cols + t]));
+		return index;
+	}
+
+	template <
+		Scalar (*project_function_hbox)(const BBox&, const Hitbox&),
+		Scalar (*project_function_seg)(const BBox&, const Segment&),
+		bool horizontal, int step
+	>
+	Scalar SolidScene::project_free_direction(const BBox& bbox, Scalar max, Hitbox** hbox_p_dest, Segment** seg_p_dest)
+	{
+		// solids are checked before segments, and on equal distance the earlier one wins.
+		// cells are visited in a different order, so keep the closest of each kind separately
+		Scalar dist = infinity<Scalar>(), seg_dist = infinity<Scalar>(), cdist;
 		Hitbox* closest_hitbox = 0;
 		Segment* closest_segment = 0;
-		for (size_t i = 0; i < this->_solidsC; i++)
+		IWEMU_COUNT(projections);
+
+		// "along" is the axis of projection, "across" is the other one
+		int x = pixel(bbox.x), y = pixel(bbox.y);
+		int w = (int)bbox.width, h = (int)bbox.height;
+		Scalar pos = horizontal ? bbox.x : bbox.y;
+		Scalar size = horizontal ? bbox.width : bbox.height;
+		int across1, across2, along, along_end;
+		// boxes of static solids in the direction are the ones past limit
+		bool kernel = kernel_range(bbox.x) && kernel_range(bbox.y);
+		Hitbox pixels = { x, y, bbox.width, bbox.height, 0, 0 };
+		// merged objects can answer differently from their parts for a box without size
+		bool thin_box = thin(pixels);
+		int limit = step < 0 ? (int)ceil_pixel(pos) - 1 : (int)floor_pixel(pos) + 1;
+		const Direction dir = horizontal ? (step < 0 ? Direction::LEFT : Direction::RIGHT) : (step < 0 ? Direction::UP : Direction::DOWN);
+		// tiles are one more solid: the closest of them is found by a scan of bits first,
+		// and the cells only have to be walked up to it
+		Scalar tile_dist = infinity<Scalar>();
+		if (this->_tiles)
 		{
-			cdist = project_function_hbox(bbox, this->_solids[i]);
-			if (cdist < dist)
+			if (kernel)
 			{
-				dist = cdist;
-				closest_hitbox = this->_solids + i;
+				Hitbox tiles[2];
+				int n = this->_tiles->nearest(dir, pixels, limit, tiles);
+				for (int k = 0; k < n; k++)
+					tile_dist = std::min(tile_dist, project_function_hbox(bbox, tiles[k]));
+			}
+			else
+			{	// too far for limit to fit in an int, every tile is looked at
+				for (int row = 0; row < this->_tiles->rows(); row++)
+					for (int col = 0; col < this->_tiles->cols(); col++)
+						if (this->_tiles->get(col, row))
+							tile_dist = std::min(tile_dist, project_function_hbox(bbox, this->_tiles->tile(col, row)));
 			}
 		}
-		for (size_t i = 0; i < this->_segmentsC; i++)
+		if (horizontal)
+		{
+			across1 = this->_grid.row_of(y);
+			across2 = this->_grid.row_of(y + (h ? h : 1) - 1);
+			along = step < 0 ? this->_grid.col_of(w ? x + w - 1 : x) : this->_grid.col_of(x);
+			along_end = step < 0 ? -1 : this->_grid.cols();
+		}
+		else
+		{
+			across1 = this->_grid.col_of(x);
+			across2 = this->_grid.col_of(x + (w ? w : 1) - 1);
+			along = step < 0 ? this->_grid.row_of(h ? y + h - 1 : y) : this->_grid.row_of(y);
+			along_end = step < 0 ? -1 : this->_grid.rows();
+		}
+
+		for (; along != along_end; along += step)
 		{
-			cdist = project_function_seg(bbox, this->_segments[i]);
-			if (cdist < dist)
+			for (int across = across1; across <= across2; across++)
 			{
-				dist = cdist;
-				closest_hitbox = 0;
-				closest_segment = this->_segments + i;
+				int col = horizontal ? along : across, row = horizontal ? across : along;
+				for (int kind = 0; kind < 2; kind++)
+				{	// static objects, then moving ones
+					SolidGrid::Cell cell = kind == 0 ? 
+						this->_grid.static_cell(col, row) : this->_grid.moving_cell(col, row);
+					const MergedSolids* merged = cell.merged_solids;
+					// positions in the cell to look at, all of them if there is no pick
+					size_t count = cell.solidsC, picked[2];
+					const size_t* pick = 0;
+					if (kernel && !thin_box && cell.boxes.x && cell.solidsC >= SIMD_MIN)
+					{	// only two of the boxes can be the closest, the rest is skipped
+						IWEMU_COUNT_N(project_tests, cell.solidsC);
+						NearestBoxes near = nearest_boxes(cell.boxes, cell.solidsC, dir, pixels, limit);
+						// unless some of them are merged: parts of another one next to a box inside of a merged solid
+						// can be closer, and of a few at the same distance the first one isn't the one of the first part.
+						// the whole cell is looked at then
+						if (near.touching == NOT_FOUND &&
+							(near.nearest == NOT_FOUND || merged->parts_of(cell.solids[near.nearest]) == 1))
+						{
+							picked[0] = near.nearest;
+							pick = picked;
+							count = 1;
+						}
+					}
+					for (size_t k = 0; k < count; k++)
+					{
+						size_t p = pick ? pick[k] : k;
+						if (p == NOT_FOUND) continue;
+						size_t i = cell.solids[p];
+						if (!pick) IWEMU_COUNT(project_tests);
+						Hitbox* found;
+						if (merged)
+						{	// found is the closest part of a merged solid
+							const Hitbox& cs = merged->boxes[i];
+							const unsigned int* parts = merged->parts + merged->offsets[i];
+							size_t partsC = merged->parts_of(i);
+							cdist = project_function_hbox(bbox, cs);
+							if (partsC == 1)
+								found = cell.solid_array + parts[0];
+							else if (thin_box || intersect(pixels, cs))
+							{	// parts can answer differently, all of them are looked at
+								cdist = closest_part<Hitbox, project_function_hbox>(parts, partsC, cell.solid_array, bbox, found);
+							}
+							else if (cdist != infinity<Scalar>() && cdist <= dist)
+								found = cell.solid_array + facing_part<horizontal, step>(*merged, i, pixels);
+							else
+								continue;
+						}
+						else
+						{
+							found = cell.solid_array + i;
+							cdist = project_function_hbox(bbox, *found);
+						}
+						if (cdist < dist || (cdist == dist && cdist != infinity<Scalar>() && found < closest_hitbox))
+						{
+							dist = cdist;
+							closest_hitbox = found;
+						}
+					}
+					const MergedSegments* merged_segments = cell.merged_segments;
+					for (size_t k = 0; k < cell.segmentsC; k++)
+					{
+						size_t i = cell.segments[k];
+						IWEMU_COUNT(project_tests);
+						Segment* found;
+						if (merged_segments)
+						{
+							const unsigned int* parts = merged_segments->parts + merged_segments->offsets[i];
+							size_t partsC = merged_segments->parts_of(i);
+							cdist = project_function_seg(bbox, merged_segments->segments[i]);
+							if (partsC == 1)
+								found = cell.segment_array + parts[0];
+							else if (thin_box || (cdist != infinity<Scalar>() && cdist <= seg_dist))
+							{	// same distance for every part, but not every one is in the way
+								cdist = closest_part<Segment, project_function_seg>(parts, partsC, cell.segment_array, bbox, found);
+							}
+							else
+								continue;
+						}
+						else
+						{
+							found = cell.segment_array + i;
+							cdist = project_function_seg(bbox, *found);
+						}
+						if (cdist < seg_dist || (cdist == seg_dist && cdist != infinity<Scalar>() && found < closest_segment))
+						{
+							seg_dist = cdist;
+							closest_segment = found;
+						}
+					}
+				}
 			}
+			// everything not seen yet, static or moving, lies entirely behind the border of this cell.
+			// if even that border is farther than the closest thing of any kind, we are done.
+			// at the same distance an earlier solid or segment can still be behind it, so keep going then
+			Scalar bound;
+			if (step < 0)
+				bound = pos - (horizontal ? this->_grid.col_x(along) : this->_grid.row_y(along));
+			else
+				bound = (horizontal ? this->_grid.col_x(along + 1) : this->_grid.row_y(along + 1)) - (pos + size);
+			if (bound > std::min(std::min(dist, seg_dist), tile_dist) || bound > max)
+				break;
+		}
+
+		Hitbox* closest_hitbox_p = 0;
+		Segment* closest_segment_p = 0;
+		if (tile_dist < dist && tile_dist <= seg_dist)
+		{
+			dist = tile_dist;
+		}
+		else if (seg_dist < dist)
+		{
+			dist = seg_dist;
+			closest_segment_p = closest_segment;
 		}
-		if (hbox_p_dest) *hbox_p_dest = closest_hitbox;
-		if (seg_p_dest) *seg_p_dest = closest_segment;
+		else if (dist != infinity<Scalar>())
+		{
+			closest_hitbox_p = closest_hitbox;
+		}
+		if (hbox_p_dest) *hbox_p_dest = closest_hitbox_p;
+		if (seg_p_dest) *seg_p_dest = closest_segment_p;
 		return dist;
 	}
 
-	double SolidScene::project_free_left(const BBox& bbox, Hitbox** hbox_p_dest, Segment** seg_p_dest)
+	Scalar SolidScene::project_free_left(const BBox& bbox, Hitbox** hbox_p_dest, Segment** seg_p_dest)
+	{
+		return this->project_free_direction<project_left, project_left, true, -1>(bbox, infinity<Scalar>(), hbox_p_dest, seg_p_dest);
+	}
+
+	Scalar SolidScene::project_free_up(const BBox& bbox, Hitbox** hbox_p_dest, Segment** seg_p_dest)
+	{
+		return this->project_free_direction<project_up, project_up, false, -1>(bbox, infinity<Scalar>(), hbox_p_dest, seg_p_dest);
+	}
+
+	Scalar SolidScene::project_free_right(const BBox& bbox, Hitbox** hbox_p_dest, Segment** seg_p_dest)
+	{
+		return this->project_free_direction<project_right, project_right, true, 1>(bbox, infinity<Scalar>(), hbox_p_dest, seg_p_dest);
+	}
+
+	Scalar SolidScene::project_free_down(const BBox& bbox, Hitbox** hbox_p_dest, Segment** seg_p_dest)
 	{
-		return this->project_free_direction(bbox, hbox_p_dest, seg_p_dest, project_left, project_left);
+		return this->project_free_direction<project_down, project_down, false, 1>(bbox, infinity<Scalar>(), hbox_p_dest, seg_p_dest);
 	}
 
-	double SolidScene::project_free_up(const BBox& bbox, Hitbox** hbox_p_dest, Segment** seg_p_dest)
+	Scalar SolidScene::project_free_left_within(const BBox& bbox, Scalar max, Hitbox** hbox_p_dest, Segment** seg_p_dest)
 	{
-		return this->project_free_direction(bbox, hbox_p_dest, seg_p_dest, project_up, project_up);
+		return this->project_free_direction<project_left, project_left, true, -1>(bbox, max, hbox_p_dest, seg_p_dest);
 	}
 
-	double SolidScene::project_free_right(const BBox& bbox, Hitbox** hbox_p_dest, Segment** seg_p_dest)
+	Scalar SolidScene::project_free_up_within(const BBox& bbox, Scalar max, Hitbox** hbox_p_dest, Segment** seg_p_dest)
 	{
-		return this->project_free_direction(bbox, hbox_p_dest, seg_p_dest, project_right, project_right);
+		return this->project_free_direction<project_up, project_up, false, -1>(bbox, max, hbox_p_dest, seg_p_dest);
 	}
 
-	double SolidScene::project_free_down(const BBox& bbox, Hitbox** hbox_p_dest, Segment** seg_p_dest)
+	Scalar SolidScene::project_free_right_within(const BBox& bbox, Scalar max, Hitbox** hbox_p_dest, Segment** seg_p_dest)
 	{
-		return this->project_free_direction(bbox, hbox_p_dest, seg_p_dest, project_down, project_down);
+		return this->project_free_direction<project_right, project_right, true, 1>(bbox, max, hbox_p_dest, seg_p_dest);
+	}
+
+	Scalar SolidScene::project_free_down_within(const BBox& bbox, Scalar max, Hitbox** hbox_p_dest, Segment** seg_p_dest)
+	{
+		return this->project_free_direction<project_down, project_down, false, 1>(bbox, max, hbox_p_dest, seg_p_dest);
+	}
+
+	// box around bbox that everything it can run into on a move by (dx, dy) intersects: the box in pixels,
+	// grown by the move and a couple of pixels of rounding. false if that doesn't fit in an int
+	static bool near_area(const BBox& bbox, Scalar dx, Scalar dy, Hitbox& area)
+	{
+		const int far = 1 << 28;
+		if (!kernel_range(bbox.x) || !kernel_range(bbox.y) || !(dx > -far && dx < far) || !(dy > -far && dy < far) ||
+			bbox.width > (unsigned int)far || bbox.height > (unsigned int)far)
+			return false;
+		int mx = (int)ceil_pixel(dx < 0 ? -dx : dx) + 2, my = (int)ceil_pixel(dy < 0 ? -dy : dy) + 2;
+		area = {
+			(int)pixel(bbox.x) - mx, (int)pixel(bbox.y) - my,
+			bbox.width + 2 * (unsigned int)mx, bbox.height + 2 * (unsigned int)my, 0, 0
+		};
+		return true;
+	}
+
+	void SolidScene::gather(const Hitbox& near, bool all)
+	{
+		this->_near_solids.clear();
+		this->_near_segments.clear();
+		this->_near_tiles.clear();
+		if (all && !this->_world)
+		{
+			for (size_t i = 0; i < this->_solidsC; i++)
+				this->_near_solids.push_back(this->_solids + i);
+			for (size_t i = 0; i < this->_segmentsC; i++)
+				this->_near_segments.push_back(this->_segments + i);
+			if (this->_tiles)
+				for (int row = 0; row < this->_tiles->rows(); row++)
+					for (int col = 0; col < this->_tiles->cols(); col++)
+						if (this->_tiles->get(col, row))
+							this->_near_tiles.push_back(this->_tiles->tile(col, row));
+			return;
+		}
+
+		// static objects of a world are only in the chunks, everything there is is what their cells have
+		const Hitbox everywhere = { -(1 << 30), -(1 << 30), 1u << 31, 1u << 31, 0, 0 };
+		const Hitbox& area = all ? everywhere : near;
+		SolidGrid::CellRange r = this->_grid.range(area);
+		for (int row = r.row1; row <= r.row2; row++)
+		{
+			for (int col = r.col1; col <= r.col2; col++)
+			{
+				for (int kind = 0; kind < 2; kind++)
+				{
+					SolidGrid::Cell cell = kind == 0 ?
+						this->_grid.static_cell(col, row) : this->_grid.moving_cell(col, row);
+					const MergedSolids* merged = cell.merged_solids;
+					for (size_t k = 0; k < cell.solidsC; k++)
+					{
+						size_t i = cell.solids[k];
+						if (!merged)
+						{
+							if (intersect(area, cell.solid_array[i])) this->_near_solids.push_back(cell.solid_array + i);
+							continue;
+						}
+						const Hitbox& cs = merged->boxes[i];
+						if (!intersect(area, cs)) continue;
+						const unsigned int* parts = merged->parts + merged->offsets[i];
+						if (merged->parts_of(i) == 1)
+						{	// it can be without size, and isn't a grid of anything
+							this->_near_solids.push_back(cell.solid_array + parts[0]);
+							continue;
+						}
+						// parts are a grid of equal blocks, only the ones under area are taken
+						int64_t cols = merged->cols[i], rows = (int64_t)merged->parts_of(i) / cols;
+						int64_t w = cs.width / cols, h = cs.height / rows;
+						int64_t c1 = std::max(floor_div((int64_t)area.x - cs.x, w), (int64_t)0);
+						int64_t c2 = std::min(floor_div((int64_t)area.x + area.width - 1 - cs.x, w), cols - 1);
+						int64_t r1 = std::max(floor_div((int64_t)area.y - cs.y, h), (int64_t)0);
+						int64_t r2 = std::min(floor_div((int64_t)area.y + area.height - 1 - cs.y, h), rows - 1);
+						for (int64_t pr = r1; pr <= r2; pr++)
+							for (int64_t pc = c1; pc <= c2; pc++)
+								this->_near_solids.push_back(cell.solid_array + parts[pr * cols + pc]);
+					}
+					const MergedSegments* merged_segments = cell.merged_segments;
+					for (size_t k = 0; k < cell.segmentsC; k++)
+					{
+						size_t i = cell.segments[k];
+						if (!merged_segments)
+						{
+							if (intersect(area, cell.segment_array[i])) this->_near_segments.push_back(cell.segment_array + i);
+							continue;
+						}
+						if (!intersect(area, merged_segments->segments[i])) continue;
+						for (unsigned int p = merged_segments->offsets[i]; p < merged_segments->offsets[i + 1]; p++)
+						{
+							Segment* part = cell.segment_array + merged_segments->parts[p];
+							if (intersect(area, *part)) this->_near_segments.push_back(part);
+						}
+					}
+				}
+			}
+		}
+		// objects of a few cells were taken once per cell
+		std::sort(this->_near_solids.begin(), this->_near_solids.end());
+		this->_near_solids.erase(std::unique(this->_near_solids.begin(), this->_near_solids.end()), this->_near_solids.end());
+		std::sort(this->_near_segments.begin(), this->_near_segments.end());
+		this->_near_segments.erase(std::unique(this->_near_segments.begin(), this->_near_segments.end()), this->_near_segments.end());
+
+		if (this->_tiles)
+		{
+			const TileLayer& tiles = *this->_tiles;
+			int64_t size = tiles.tile_size();
+			int64_t c1 = std::max(floor_div((int64_t)area.x - tiles.x(), size), (int64_t)0);
+			int64_t c2 = std::min(floor_div((int64_t)area.x + area.width - 1 - tiles.x(), size), (int64_t)tiles.cols() - 1);
+			int64_t r1 = std::max(floor_div((int64_t)area.y - tiles.y(), size), (int64_t)0);
+			int64_t r2 = std::min(floor_div((int64_t)area.y + area.height - 1 - tiles.y(), size), (int64_t)tiles.rows() - 1);
+			for (int64_t row = r1; row <= r2; row++)
+				for (int64_t col = c1; col <= c2; col++)
+					if (tiles.get((int)col, (int)row))
+						this->_near_tiles.push_back(tiles.tile((int)col, (int)row));
+		}
+	}
+
+	bool SolidScene::near_solid(const Hitbox& hbox) const
+	{
+		for (const Hitbox* cs : this->_near_solids)
+			if (intersect(hbox, *cs))
+				return true;
+		for (const Hitbox& tile : this->_near_tiles)
+			if (intersect(hbox, tile))
+				return true;
+		return false;
+	}
+
+	bool SolidScene::near_free(const Hitbox& hbox) const
+	{
+		if (this->near_solid(hbox)) return false;
+		for (const Segment* cs : this->_near_segments)
+			if (intersect(hbox, *cs))
+				return false;
+		return true;
+	}
+
+	template <
+		Scalar (*project_function_hbox)(const BBox&, const Hitbox&),
+		Scalar (*project_function_seg)(const BBox&, const Segment&)
+	>
+	Scalar SolidScene::near_distance(const BBox& bbox) const
+	{
+		Scalar dist = infinity<Scalar>();
+		for (const Hitbox* cs : this->_near_solids)
+			dist = std::min(dist, project_function_hbox(bbox, *cs));
+		for (const Hitbox& tile : this->_near_tiles)
+			dist = std::min(dist, project_function_hbox(bbox, tile));
+		for (const Segment* cs : this->_near_segments)
+			dist = std::min(dist, project_function_seg(bbox, *cs));
+		return dist;
+	}
+
+	// when a box moving by d from [from, from + size) is over [start, start + length) on one axis, in parts of
+	// the move. if it doesn't move along the axis, it's over it all the time or never, as the pixels tell
+	static void sweep_axis(Scalar from, unsigned int size, Scalar d, int start, unsigned int length, Scalar& enter, Scalar& leave)
+	{
+		if (d == 0)
+		{
+			bool over = intersect((int)pixel(from), size, start, length);
+			enter = over ? -infinity<Scalar>() : infinity<Scalar>();
+			leave = over ? infinity<Scalar>() : -infinity<Scalar>();
+			return;
+		}
+		Scalar a = (Scalar(start) - (from + size)) / d, b = (Scalar(start) + Scalar(length) - from) / d;
+		enter = std::min(a, b);
+		leave = std::max(a, b);
+	}
+
+	// does the box hit a solid before hit.time. if it does, hit gets the time and the normal
+	static bool sweep_box(const BBox& bbox, const Hitbox& pixels, Scalar dx, Scalar dy, const Hitbox& hbox, SolidScene::Hit& hit)
+	{
+		if (intersect(pixels, hbox))
+		{	// inside of it already
+			if (!(hit.time > 0)) return false;
+			hit.time = 0;
+			hit.normal_x = hit.normal_y = 0;
+			return true;
+		}
+		Scalar enter_x, leave_x, enter_y, leave_y;
+		sweep_axis(bbox.x, bbox.width, dx, hbox.x, hbox.width, enter_x, leave_x);
+		sweep_axis(bbox.y, bbox.height, dy, hbox.y, hbox.height, enter_y, leave_y);
+		Scalar enter = std::max(enter_x, enter_y), leave = std::min(leave_x, leave_y);
+		if (!(enter < leave) || !(leave > 0)) return false;
+		int normal_x = dx != 0 && !(enter_x < enter_y) ? (dx > 0 ? -1 : 1) : 0;
+		int normal_y = dy != 0 && !(enter_y < enter_x) ? (dy > 0 ? -1 : 1) : 0;
+		if (enter < 0)
+		{	// over it already, but not in pixels. like projections, it's hit if it's ahead, and left behind if not
+			normal_x = (dx > 0 && hbox.x > bbox.x) || (dx < 0 && hbox.x < bbox.x) ? (dx > 0 ? -1 : 1) : 0;
+			normal_y = (dy > 0 && hbox.y > bbox.y) || (dy < 0 && hbox.y < bbox.y) ? (dy > 0 ? -1 : 1) : 0;
+			if (!normal_x && !normal_y) return false;
+			enter = 0;
+		}
+		if (!(enter < hit.time)) return false;
+		hit.time = enter;
+		hit.normal_x = normal_x;
+		hit.normal_y = normal_y;
+		return true;
+	}
+
+	// same for a segment, that only blocks a box coming from the sides it blocks
+	static bool sweep_segment(const BBox& bbox, Scalar dx, Scalar dy, const Segment& seg, SolidScene::Hit& hit)
+	{
+		Scalar t, enter, leave;
+		int normal_x = 0, normal_y = 0;
+		if (seg.vertical)
+		{
+			if (dx > 0 && seg.block_lt && seg.x >= pixel(right(bbox)))
+				normal_x = -1;
+			else if (dx < 0 && seg.block_rb && seg.x <= pixel(left(bbox)))
+				normal_x = 1;
+			else
+				return false;
+			t = (seg.x - (dx > 0 ? right(bbox) : left(bbox))) / dx;
+			sweep_axis(bbox.y, bbox.height, dy, seg.y, seg.length, enter, leave);
+		}
+		else
+		{
+			if (dy > 0 && seg.block_lt && seg.y >= pixel(bottom(bbox)))
+				normal_y = -1;
+			else if (dy < 0 && seg.block_rb && seg.y <= pixel(top(bbox)))
+				normal_y = 1;
+			else
+				return false;
+			t = (seg.y - (dy > 0 ? bottom(bbox) : top(bbox))) / dy;
+			sweep_axis(bbox.x, bbox.width, dx, seg.x, seg.length, enter, leave);
+		}
+		// less than half a pixel past the line still counts as before it
+		if (t < 0) t = 0;
+		if (!(t < hit.time) || !(enter < t) || !(t < leave)) return false;
+		hit.time = t;
+		hit.normal_x = normal_x;
+		hit.normal_y = normal_y;
+		return true;
+	}
+
+	SolidScene::Hit SolidScene::sweep(const BBox& bbox, Scalar dx, Scalar dy)
+	{
+		Hitbox area;
+		this->gather(area, !near_area(bbox, dx, dy, area));
+		Hit hit = { Scalar(1), 0, 0, 0, 0 };
+		Hitbox pixels = get_hitbox(bbox);
+		// things are looked at in the order they win ties in, and only an earlier one replaces the hit.
+		// it's the same order as in project_free_*
+		for (Hitbox* cs : this->_near_solids)
+			if (sweep_box(bbox, pixels, dx, dy, *cs, hit))
+				hit.solid = cs;
+		for (const Hitbox& tile : this->_near_tiles)
+			if (sweep_box(bbox, pixels, dx, dy, tile, hit))
+				hit.solid = 0;
+		for (Segment* cs : this->_near_segments)
+			if (sweep_segment(bbox, dx, dy, *cs, hit))
+			{
+				hit.solid = 0;
+				hit.segment = cs;
+			}
+		return hit;
+	}
+
+	const SolidScene::Side& SolidScene::touching(size_t k, Direction side)
+	{
+		Contact& c = this->_contacts[k];
+		Side& found = c.sides[(int)side];
+		unsigned int bit = 1u << (int)side;
+		if (c.known & bit) return found;
+		c.known |= bit;
+		found = { infinity<Scalar>(), 0, 0 };
+		if (!this->alive[k]) return found;
+		const BBox& cc = this->_collidable[k];
+		Hitbox* solid;
+		Segment* segment;
+		Scalar dist;
+		switch (side)
+		{
+		case Direction::LEFT: dist = this->project_free_left_within(cc, CONTACT_RANGE, &solid, &segment); break;
+		case Direction::UP: dist = this->project_free_up_within(cc, CONTACT_RANGE, &solid, &segment); break;
+		case Direction::RIGHT: dist = this->project_free_right_within(cc, CONTACT_RANGE, &solid, &segment); break;
+		default: dist = this->project_free_down_within(cc, CONTACT_RANGE, &solid, &segment); break;
+		}
+		if (dist <= CONTACT_RANGE)
+			found = { dist, solid, segment };
+		return found;
+	}
+
+	const SolidScene::Contact& SolidScene::contact(size_t k)
+	{
+		for (int side = 0; side < 4; side++)
+			this->touching(k, (Direction)side);
+		return this->_contacts[k];
+	}
+
+	void SolidScene::refresh_contact(size_t k)
+	{
+		Contact& c = this->_contacts[k];
+		c.known = 0;
+		if (this->alive[k]) c.death = Death::NONE;
+	}
+
+	void SolidScene::refresh_contacts()
+	{
+		for (size_t k = 0; k < this->_collidableC; k++)
+			this->refresh_contact(k);
 	}
 
 	SolidScene::CollisionSide SolidScene::collision_side(const BBox& bbox, const Hitbox& hbox, int dx, int dy)
@@ -268,6 +1425,26 @@ namespace iwemu
 		}
 	}
 
+	const unsigned int* SolidScene::candidates(unsigned int mover, size_t& count)
+	{
+		if (this->_escaped)
+		{	// pairs can't be trusted anymore, look at everyone
+			count = this->_collidableC;
+			return this->_all_collidables.data();
+		}
+		return this->_broadphase.candidates(mover, count);
+	}
+
+	void SolidScene::track_escape(size_t k)
+	{
+		// a collidable that got pushed out of the box it was paired with
+		// may meet movers that weren't paired with it
+		const Hitbox& box = this->_collidable_reach[k];
+		Hitbox cc = get_hitbox(this->_collidable[k]);
+		if (cc.x < box.x || cc.y < box.y || right(cc) > right(box) || bottom(cc) > bottom(box))
+			this->_escaped = true;
+	}
+
 	void SolidScene::update()
 	{
 		// update dynamic solids. for each solid 
@@ -276,42 +1453,97 @@ namespace iwemu
 		// (move it until it hits a solid)
 		// then update the player
 
-		// map the solids based on how they affect the player
-		bool* done_solids = new bool[this->_solidsC] {false};
-		bool* done_segments = new bool[this->_segmentsC] {false};
-		bool* standing = new bool[this->_collidableC] {false};
-		// do all horizontal and downwards carrying first
-		for (size_t i = 0; i < this->_solidsC; i++)
+		// chunks of a world go in and out before anything moves
+		IWEMU_PHASE(clock);
+		this->stream();
+		IWEMU_LAP(clock, streaming_ns);
+
+		// pair up movers with the collidables they can reach this frame, once.
+		// collidables can be carried or pushed by other movers before they get to a mover,
+		// so their boxes are grown by a couple of steps of the fastest mover
+		size_t moving_solidsC = this->_moving_solids.size();
+		int max_speed = 0;
+		this->_broadphase.clear();
+		for (size_t m = 0; m < moving_solidsC; m++)
+		{
+			const Hitbox& cs = this->_solids[this->_moving_solids[m]];
+			max_speed = std::max(max_speed, std::max(abs(cs.dx), abs(cs.dy)));
+			this->_broadphase.add_mover((unsigned int)m, reach(cs));
+		}
+		for (size_t m = 0; m < this->_moving_segments.size(); m++)
+		{
+			const Segment& cs = this->_segments[this->_moving_segments[m]];
+			max_speed = std::max(max_speed, std::max(abs(cs.dx), abs(cs.dy)));
+			this->_broadphase.add_mover((unsigned int)(moving_solidsC + m), reach(cs));
+		}
+		int margin = 2 * max_speed + 2;
+		for (size_t k = 0; k < this->_collidableC; k++)
 		{
+			if (!this->alive[k]) continue;
+			Hitbox cc = get_hitbox(this->_collidable[k]);
+			Hitbox& box = this->_collidable_reach[k];
+			box = { cc.x - margin, cc.y - margin, cc.width + 2 * margin, cc.height + 2 * margin, 0, 0 };
+			this->_broadphase.add_collidable((unsigned int)k, box);
+		}
+		this->_broadphase.run(moving_solidsC + this->_moving_segments.size());
+		this->_escaped = false;
+		IWEMU_LAP(clock, pairing_ns);
+
+		// map the solids based on how they affect the player.
+		// buffers live as long as the scene, so there are no allocations each frame
+		std::fill(this->_done.begin(), this->_done.end(), false);
+		std::fill(this->_standing.begin(), this->_standing.end(), false);
+		for (size_t k = 0; k < this->_collidableC; k++)
+		{
+			Contact& c = this->_contacts[k];
+			c.known = 0;
+			c.carried_by_solid = 0;
+			c.carried_by_segment = 0;
+			if (this->alive[k]) c.death = Death::NONE;
+		}
+
+		// do all horizontal and downwards carrying first.
+		// solids that don't move can't carry or push, so only moving ones are looked at
+		for (size_t m = 0; m < this->_moving_solids.size(); m++)
+		{
+			size_t i = this->_moving_solids[m];
 			Hitbox& cs = this->_solids[i];
-			for (size_t k = 0; k < this->_collidableC; k++)
+			Hitbox cs_reach = reach(cs);
+			size_t candidatesC;
+			const unsigned int* candidates = this->candidates((unsigned int)m, candidatesC);
+			for (size_t c = 0; c < candidatesC; c++)
 			{
+				size_t k = candidates[c];
 				if (!this->alive[k]) continue;
 				BBox& cc = this->_collidable[k];
-				if (intersect(get_hitbox(rel(cc, 0.0, this->grav_dir)), cs) && 
+				if (!intersect(get_hitbox(cc), cs_reach)) continue;
+				if (intersect(get_hitbox(rel(cc, 0, this->grav_dir)), cs) && 
 					!intersect(get_hitbox(cc), cs))
 				{	// if standing on a solid, it can carry us.
 					// horizontal and downwards are carries that can be done 
 					// by "softly" pushing collidable. upwards carrying 
 					// might slam us into ceiling, so it will be done in pushing part
-					standing[k] = true;
+					this->_standing[k] = true;
+					if (cs.dx != 0 || cs.dy * this->grav_dir > 0)
+						this->_contacts[k].carried_by_solid = &cs;
 					if (cs.dx != 0)
 					{	// it moves horizontally
 						// try to move horizontally as well
 						int carryX = cs.dx;
-						done_solids[i] = true;
-						if (place_free(get_hitbox(rel(cc, carryX, 0.0))))
+						IWEMU_COUNT(carries);
+						this->_done[m] = true;
+						if (place_free(get_hitbox(rel(cc, carryX, 0))))
 						{	// nothing stands in our way
 							cc.x += carryX;
 						}
 						else
 						{	// something is standing in our way
-							double dist = 0.0;
+							Scalar dist = 0;
 							if (carryX > 0)
 							{	// wanna go right
 								dist = project_free_right(cc);
 								if (dist < carryX)
-									dist = round(dist);
+									dist = round_pixel(dist);
 								else
 									dist = carryX;
 							}
@@ -319,7 +1551,7 @@ namespace iwemu
 							{	// wanna go left
 								dist = project_free_left(cc);
 								if (dist < -carryX)
-									dist = -round(dist);
+									dist = -round_pixel(dist);
 								else
 									dist = carryX;
 							}
@@ -329,21 +1561,22 @@ namespace iwemu
 					if (cs.dy * this->grav_dir > 0)
 					{	// it (also) moves down
 						int carryY = cs.dy;
+						IWEMU_COUNT(carries);
 						// move the solid down, so it doesn't register as collision
-						cs.y += cs.dy;
-						done_solids[i] = true;
-						if (place_free(get_hitbox(rel(cc, 0.0, carryY))))
+						this->move_solid(m, 0, cs.dy);
+						this->_done[m] = true;
+						if (place_free(get_hitbox(rel(cc, 0, carryY))))
 						{	// nothing stands in our way
 							cc.y += carryY;
 						}
 						else
 						{	// something is in our way
-							double dist = 0.0;
+							Scalar dist = 0;
 							if (grav_dir > 0)
 							{
 								dist = project_free_down(cc);
 								if (dist < carryY)
-									dist = round(dist);
+									dist = round_pixel(dist);
 								else
 									dist = carryY;
 							}
@@ -351,7 +1584,7 @@ namespace iwemu
 							{
 								dist = project_free_up(cc);
 								if (dist < -carryY)
-									dist = -round(dist);
+									dist = -round_pixel(dist);
 								else
 									dist = carryY;
 							}
@@ -359,50 +1592,60 @@ namespace iwemu
 							
 						}
 						// have to move back up to move it properly later
-						cs.y -= cs.dy;
+						this->move_solid(m, 0, -cs.dy);
 					}
 				}
+				this->track_escape(k);
 			}
 			// after all collidables were carried, move the solid that did the carry, 
 			// since bc of downwards carrying collidable will be inside a solid, 
 			// and we want to ignore that
-			if (done_solids[i])
+			if (this->_done[m])
 			{
-				cs.x += cs.dx;
-				cs.y += cs.dy;
+				this->move_solid(m, cs.dx, cs.dy);
 			}
 		}
+		IWEMU_LAP(clock, carry_solids_ns);
 		
 		// do the same with segments
-		for (size_t i = 0; i < this->_segmentsC; i++)
+		for (size_t m = 0; m < this->_moving_segments.size(); m++)
 		{
+			size_t i = this->_moving_segments[m];
 			Segment& cs = this->_segments[i];
 			if (cs.vertical || !cs.block_lt) continue;	// vertical segments can't carry.
 														// as well as those who not block top.
-			for (size_t k = 0; k < this->_collidableC; k++)
+			Hitbox cs_reach = reach(cs);
+			size_t candidatesC;
+			const unsigned int* candidates = this->candidates((unsigned int)(moving_solidsC + m), candidatesC);
+			for (size_t c = 0; c < candidatesC; c++)
 			{
+				size_t k = candidates[c];
 				if (!this->alive[k]) continue;
 				BBox& cc = this->_collidable[k];
-				if (intersect(get_hitbox(rel(cc, 0.0, this->grav_dir)), cs) &&
+				if (!intersect(get_hitbox(cc), cs_reach)) continue;
+				if (intersect(get_hitbox(rel(cc, 0, this->grav_dir)), cs) &&
 					!intersect(get_hitbox(cc), cs))
 				{
+					if (cs.dx != 0 || cs.dy * this->grav_dir > 0)
+						this->_contacts[k].carried_by_segment = &cs;
 					if (cs.dx != 0)
 					{	// it moves horizontally
 						// try to move horizontally as well
 						int carryX = cs.dx;
-						done_segments[i] = true;
-						if (place_free(get_hitbox(rel(cc, carryX, 0.0))))
+						IWEMU_COUNT(carries);
+						this->_done[moving_solidsC + m] = true;
+						if (place_free(get_hitbox(rel(cc, carryX, 0))))
 						{	// nothing stands in our way
 							cc.x += carryX;
 						}
 						else
 						{	// something is standing in our way
-							double dist = 0.0;
+							Scalar dist = 0;
 							if (carryX > 0)
 							{	// wanna go right
 								dist = project_free_right(cc);
 								if (dist < carryX)
-									dist = round(dist);
+									dist = round_pixel(dist);
 								else
 									dist = carryX;
 							}
@@ -410,7 +1653,7 @@ namespace iwemu
 							{	// wanna go left
 								dist = project_free_left(cc);
 								if (dist < -carryX)
-									dist = -round(dist);
+									dist = -round_pixel(dist);
 								else
 									dist = carryX;
 							}
@@ -420,21 +1663,22 @@ namespace iwemu
 					if (cs.dy * this->grav_dir > 0)
 					{	// it (also) moves down
 						int carryY = cs.dy;
+						IWEMU_COUNT(carries);
 						// move the solid down, so it doesn't register as collision
-						cs.y += cs.dy;
-						done_segments[i] = true;
-						if (place_free(get_hitbox(rel(cc, 0.0, carryY))))
+						this->move_segment(m, 0, cs.dy);
+						this->_done[moving_solidsC + m] = true;
+						if (place_free(get_hitbox(rel(cc, 0, carryY))))
 						{	// nothing stands in our way
 							cc.y += carryY;
 						}
 						else
 						{	// something is in our way
-							double dist = 0.0;
+							Scalar dist = 0;
 							if (grav_dir > 0)
 							{
 								dist = project_free_down(cc);
 								if (dist < carryY)
-									dist = round(dist);
+									dist = round_pixel(dist);
 								else
 									dist = carryY;
 							}
@@ -442,7 +1686,7 @@ namespace iwemu
 							{
 								dist = project_free_up(cc);
 								if (dist < -carryY)
-									dist = -round(dist);
+									dist = -round_pixel(dist);
 								else
 									dist = carryY;
 							}
@@ -450,19 +1694,20 @@ namespace iwemu
 
 						}
 						// have to move back up to move it properly later
-						cs.y -= cs.dy;
+						this->move_segment(m, 0, -cs.dy);
 					}
 				}
+				this->track_escape(k);
 			}
 			// after all collidables were carried, move the solid that did the carry, 
 			// since bc of downwards carrying collidable will be inside a solid, 
 			// and we want to ignore that
-			if (done_segments[i])
+			if (this->_done[moving_solidsC + m])
 			{
-				cs.x += cs.dx;
-				cs.y += cs.dy;
+				this->move_segment(m, cs.dx, cs.dy);
 			}
 		}
+		IWEMU_LAP(clock, carry_segments_ns);
 
 		// carry finished. 
 		// all objects marked true in done_ have been moved, and no longer
@@ -470,19 +1715,34 @@ namespace iwemu
 		// all objects not marked true in done_
 		// should resolve collision by pushing
 
-		for (size_t i = 0; i < this->_solidsC; i++)
+		// static solids were skipped during carrying, but they still count as ground
+		for (size_t k = 0; k < this->_collidableC; k++)
+		{
+			if (this->alive[k] && !this->_standing[k] && this->standing_on_static(this->_collidable[k]))
+				this->_standing[k] = true;
+		}
+		IWEMU_LAP(clock, standing_ns);
+
+		for (size_t m = 0; m < this->_moving_solids.size(); m++)
 		{
-			if (done_solids[i]) continue;
+			size_t i = this->_moving_solids[m];
+			if (this->_done[m]) continue;
 			Hitbox& cs = this->_solids[i];
-			for (size_t k = 0; k < this->_collidableC; k++)
+			Hitbox cs_reach = reach(cs);
+			size_t candidatesC;
+			const unsigned int* candidates = this->candidates((unsigned int)m, candidatesC);
+			for (size_t c = 0; c < candidatesC; c++)
 			{
+				size_t k = candidates[c];
 				if (!this->alive[k]) continue;
 				BBox& cc = this->_collidable[k];
+				if (!intersect(get_hitbox(cc), cs_reach)) continue;
 				if (intersect(rel(cs, cs.dx, cs.dy), get_hitbox(cc)))
 				{	// the collision will happen. push the collidable
 					// we use this function to see what side collidable
 					// will meet the solid
 					CollisionSide side = collision_side(cc, cs, cs.dx, cs.dy);
+					if (side != CollisionSide::NONE) IWEMU_COUNT(pushes);
 					switch (side)
 					{
 					case CollisionSide::NONE:
@@ -495,10 +1755,14 @@ namespace iwemu
 					case CollisionSide::TOP:
 						// will be pushed from up
 						// can do some check here to see if fell through platform (death)
-						if (grav_dir > 0 && standing[k])
+						if (grav_dir > 0 && this->_standing[k])
 						{
 							this->alive[k] = false;
+							this->_contacts[k].death = Death::CRUSHED;
+							IWEMU_COUNT(deaths);
 						}
+						else if (grav_dir < 0)
+							this->_contacts[k].carried_by_solid = &cs;
 						cc.y = bottom(cs) + cs.dy;
 					break;
 					case CollisionSide::RIGHT:
@@ -507,30 +1771,41 @@ namespace iwemu
 					break;
 					case CollisionSide::BOTTOM:
 						// will be pushed from down
-						if (grav_dir < 0 && standing[k])
+						if (grav_dir < 0 && this->_standing[k])
 						{
 							this->alive[k] = false;
+							this->_contacts[k].death = Death::CRUSHED;
+							IWEMU_COUNT(deaths);
 						}
+						else if (grav_dir > 0)
+							this->_contacts[k].carried_by_solid = &cs;
 						cc.y = top(cs) + cs.dy - cc.height;
 					break;
 
 					}
 				}
+				this->track_escape(k);
 			}
 			// after everything is pushed, we can move the solid
-			cs.x += cs.dx;
-			cs.y += cs.dy;
+			this->move_solid(m, cs.dx, cs.dy);
 		}
+		IWEMU_LAP(clock, push_solids_ns);
 
 		// do platforms pushing
-		for (size_t i = 0; i < this->_segmentsC; i++)
+		for (size_t m = 0; m < this->_moving_segments.size(); m++)
 		{
-			if (done_segments[i]) continue;
+			size_t i = this->_moving_segments[m];
+			if (this->_done[moving_solidsC + m]) continue;
 			Segment& cs = this->_segments[i];
-			for (size_t k = 0; k < this->_collidableC; k++)
+			Hitbox cs_reach = reach(cs);
+			size_t candidatesC;
+			const unsigned int* candidates = this->candidates((unsigned int)(moving_solidsC + m), candidatesC);
+			for (size_t c = 0; c < candidatesC; c++)
 			{
+				size_t k = candidates[c];
 				if (!this->alive[k]) continue;
 				BBox& cc = this->_collidable[k];
+				if (!intersect(get_hitbox(cc), cs_reach)) continue;
 				if (intersect(get_hitbox(cc), rel(cs, cs.dx, cs.dy)) &&
 					!intersect(get_hitbox(cc), cs))
 				{	// we will intersect, but can't tell whether we need to stop 
@@ -538,18 +1813,20 @@ namespace iwemu
 					{
 						if (cs.dx < 0)
 						{	// seg was going left
-							double dist = project_right(cc, cs);	// should the seg push us
+							Scalar dist = project_right(cc, cs);	// should the seg push us
 							if (dist < -cs.dx)
 							{	
 								cc.x = cs.x + cs.dx - cc.width;
+								IWEMU_COUNT(pushes);
 							}
 						}
 						else
 						{	// seg was going right
-							double dist = project_left(cc, cs);		// shoud the seg push us
+							Scalar dist = project_left(cc, cs);		// shoud the seg push us
 							if (dist < cs.dx)
 							{
 								cc.x = cs.x + cs.dx;
+								IWEMU_COUNT(pushes);
 							}
 						}
 					}
@@ -557,113 +1834,229 @@ namespace iwemu
 					{	
 						if (cs.dy < 0)
 						{	// seg was going up
-							double dist = project_down(cc, cs);
+							Scalar dist = project_down(cc, cs);
 							if (dist < -cs.dy)
 							{
 								cc.y = cs.y + cs.dy - cc.height;
+								if (this->grav_dir > 0) this->_contacts[k].carried_by_segment = &cs;
+								IWEMU_COUNT(pushes);
 							}
 						}
 						else
 						{	// seg was going down
-							double dist = project_up(cc, cs);
+							Scalar dist = project_up(cc, cs);
 							if (dist < cs.dy)
 							{
 								cc.y = cs.y + cs.dy;
+								if (this->grav_dir < 0) this->_contacts[k].carried_by_segment = &cs;
+								IWEMU_COUNT(pushes);
 							}
 						}
 					}
 				}
+				this->track_escape(k);
 			}
-			cs.x += cs.dx;
-			cs.y += cs.dy;
+			this->move_segment(m, cs.dx, cs.dy);
 		}
+		IWEMU_LAP(clock, push_segments_ns);
 
 		// now we can finally apply movement to collidables
-		// most stuff down here is done for compatibility with fangame physics
 		for (size_t i = 0; i < this->_collidableC; i++)
 		{
 			// if already dead or have to die, no hesitation
-			if (place_solid(get_hitbox(this->_collidable[i]))) this->alive[i] = false;
 			if (!this->alive[i]) continue;
+			if (!this->move_collidable(this->_collidable[i]))
+			{
+				this->alive[i] = false;
+				this->_contacts[i].death = Death::INSIDE_SOLID;
+				IWEMU_COUNT(deaths);
+			}
+		}
+		IWEMU_LAP(clock, movement_ns);
+		this->move_projectiles();
+		IWEMU_LAP(clock, projectiles_ns);
+#ifdef IWEMU_STATS
+		this->stats.end_frame();
+#endif
+	}
 
-			BBox& cc = this->_collidable[i];
-
-			// see if our desired destination is clear
-			if (!place_free(get_hitbox(rel(cc, cc.dx, cc.dy))))
-			{	
-				bool canX = false, canY = false;
-				if (cc.dx < 0)
-				{	// going left
-					double dist = project_free_left(cc);
-					if (dist < -cc.dx)
-					{	// will hit a thing
-						canX = false;
-						cc.x -= round(dist);
-						cc.dx = 0.0;
-					}
-					else
-						canX = true;
+	bool SolidScene::move_collidable(BBox& cc)
+	{
+		// everything the tests below can run into is near the box, so it's found in one pass
+		// over the cells, and the tests only look at that.
+		// sweep() isn't used here: the fangame goes one axis at a time, rounds what it projects to pixels
+		// and has its own rule for corners, and a time of impact gives other answers when both axes are blocked
+		Hitbox area;
+		bool all = !near_area(cc, cc.dx, cc.dy, area);
+		this->gather(area, all);
+		if (this->near_solid(get_hitbox(cc)))
+			return false;
+
+		// most stuff down here is done for compatibility with fangame physics
+		// see if our desired destination is clear
+		if (!this->near_free(get_hitbox(rel(cc, cc.dx, cc.dy))))
+		{	
+			bool canX = false, canY = false;
+			if (cc.dx < 0)
+			{	// going left
+				Scalar dist = this->near_distance<project_left, project_left>(cc);
+				if (dist < -cc.dx)
+				{	// will hit a thing
+					canX = false;
+					cc.x -= round_pixel(dist);
+					cc.dx = 0;
 				}
 				else
-				{	// going right perhaps
-					double dist = project_free_right(cc);
-					if (dist < cc.dx)
-					{	// will hit a thing
-						canX = false;
-						cc.x += round(dist);
-						cc.dx = 0.0;
-					}
-					else
-						canX = true;
+					canX = true;
+			}
+			else
+			{	// going right perhaps
+				Scalar dist = this->near_distance<project_right, project_right>(cc);
+				if (dist < cc.dx)
+				{	// will hit a thing
+					canX = false;
+					cc.x += round_pixel(dist);
+					cc.dx = 0;
 				}
-				if (cc.dy < 0)
-				{	// going up
-					double dist = project_free_up(cc);
-					if (dist < -cc.dy)
-					{	// will hit a thing
-						canY = false;
-						cc.y -= round(dist);
-						cc.dy = 0.0;
-					}
-					else
-						canY = true;
+				else
+					canX = true;
+			}
+			// a box without width can be pushed a long way out of something, past what was gathered
+			Hitbox moved = get_hitbox(cc);
+			bool near = all || (moved.x >= area.x && (int64_t)moved.x + moved.width <= (int64_t)area.x + area.width);
+			if (cc.dy < 0)
+			{	// going up
+				Scalar dist = near ? this->near_distance<project_up, project_up>(cc) : this->project_free_up(cc);
+				if (dist < -cc.dy)
+				{	// will hit a thing
+					canY = false;
+					cc.y -= round_pixel(dist);
+					cc.dy = 0;
 				}
 				else
-				{	// going down probably
-					double dist = project_free_down(cc);
-					if (dist < cc.dy)
-					{	// will hit a thing
-						canY = false;
-						cc.y += round(dist);
-						cc.dy = 0.0;
-					}
-					else
-						canY = true;
+					canY = true;
+			}
+			else
+			{	// going down probably
+				Scalar dist = near ? this->near_distance<project_down, project_down>(cc) : this->project_free_down(cc);
+				if (dist < cc.dy)
+				{	// will hit a thing
+					canY = false;
+					cc.y += round_pixel(dist);
+					cc.dy = 0;
+				}
+				else
+					canY = true;
+			}
+			if (canX && canY)
+			{	// corner collision. do only if solid
+				if (this->near_solid(get_hitbox(rel(cc, cc.dx, cc.dy))))
+				{
+					cc.dx = 0;
+					cc.y += cc.dy;
 				}
-				if (canX && canY)
-				{	// corner collision. do only if solid
-					if (place_solid(get_hitbox(rel(cc, cc.dx, cc.dy))))
-					{
-						cc.dx = 0;
-						cc.y += cc.dy;
-					}
-					else
-					{
-						cc.x += cc.dx;
-						cc.y += cc.dy;
-					}
-				}	
 				else
 				{
 					cc.x += cc.dx;
 					cc.y += cc.dy;
 				}
-			}
+			}	
 			else
-			{	// all clear
+			{
 				cc.x += cc.dx;
 				cc.y += cc.dy;
 			}
 		}
+		else
+		{	// all clear
+			cc.x += cc.dx;
+			cc.y += cc.dy;
+		}
+		return true;
+	}
+
+	void SolidScene::move_projectiles()
+	{
+		this->_projectile_hits.clear();
+		ProjectileArrays& p = this->_projectiles;
+		size_t n = p.tag.size();
+		if (n == 0) return;
+		// what a projectile flies over is in the box around where it is and where it goes,
+		// so if that box is free, nothing is in the way however fast it is. the boxes are made one at a time,
+		// pixel() rounds each coordinate on its own, and the batch place_free sorts them by cell and tests
+		// them one by one against what is there. only adding the speeds at the end is done a few at a time
+		Scalar* x = p.x.data();
+		Scalar* y = p.y.data();
+		const Scalar* dx = p.dx.data();
+		const Scalar* dy = p.dy.data();
+		this->_projectile_boxes.resize(n);
+		for (size_t i = 0; i < n; i++)
+		{
+			int x1 = (int)pixel(x[i]), x2 = (int)pixel(x[i] + dx[i]);
+			int y1 = (int)pixel(y[i]), y2 = (int)pixel(y[i] + dy[i]);
+			this->_projectile_boxes[i] = {
+				std::min(x1, x2), std::min(y1, y2),
+				p.width[i] + (unsigned int)abs(x2 - x1), p.height[i] + (unsigned int)abs(y2 - y1), 0, 0
+			};
+		}
+		this->_projectile_free.resize((n + 63) / 64);
+		this->place_free(this->_projectile_boxes.data(), n, this->_projectile_free.data());
+
+		// few of them have something in their way in a frame, only those are looked at again:
+		// they go a pixel at a time to where they first touch something, if they do
+		uint64_t* free = this->_projectile_free.data();
+		for (size_t i = 0; i < n; i++)
+		{
+			if ((free[i / 64] >> (i % 64)) & 1) continue;
+			Scalar adx = dx[i] < Scalar(0) ? -dx[i] : dx[i], ady = dy[i] < Scalar(0) ? -dy[i] : dy[i];
+			int steps = (int)std::max(std::max(ceil_pixel(adx), ceil_pixel(ady)), 1L);
+			Hitbox at = {};
+			bool touched = false;
+			for (int k = 1; k <= steps && !touched; k++)
+			{
+				Scalar sx = k == steps ? x[i] + dx[i] : x[i] + dx[i] * k / steps;
+				Scalar sy = k == steps ? y[i] + dy[i] : y[i] + dy[i] * k / steps;
+				at = { (int)pixel(sx), (int)pixel(sy), p.width[i], p.height[i], 0, 0 };
+				touched = !this->place_free(at);
+			}
+			if (!touched)
+			{	// only passed by something next to the way
+				free[i / 64] |= (uint64_t)1 << (i % 64);
+				continue;
+			}
+			ProjectileHit hit = { p.tag[i], at, 0, 0 };
+			// grown by a pixel, so the parts of merged solids are found for a box without size too
+			this->gather({ at.x - 1, at.y - 1, at.width + 2, at.height + 2, 0, 0 }, false);
+			bool found = false;
+			for (size_t k = 0; k < this->_near_solids.size() && !found; k++)
+			{
+				Hitbox* cs = this->_near_solids[k];
+				if (intersect(at, *cs))
+				{
+					hit.solid = cs;
+					found = true;
+				}
+			}
+			for (size_t k = 0; k < this->_near_tiles.size() && !found; k++)
+				found = intersect(at, this->_near_tiles[k]);
+			for (size_t k = 0; k < this->_near_segments.size() && !found; k++)
+			{
+				Segment* cs = this->_near_segments[k];
+				if (intersect(at, *cs))
+				{
+					hit.segment = cs;
+					found = true;
+				}
+			}
+			this->_projectile_hits.push_back(hit);
+			IWEMU_COUNT(projectile_hits);
+		}
+		for (size_t i = 0; i < n; i++)
+			x[i] += dx[i];
+		for (size_t i = 0; i < n; i++)
+			y[i] += dy[i];
+		// from the end, so the one that fills a hole has already been looked at, and didn't hit
+		for (size_t i = n; i > 0; i--)
+			if (!((free[(i - 1) / 64] >> ((i - 1) % 64)) & 1)) this->remove_projectile(i - 1);
 	}
 }
@@ -1,6 +1,13 @@
 #pragma once
 
+#include <stdint.h>
 #include "hitbox.h"
+#include "grid.h"
+#include "level.h"
+#include "world.h"
+#include "tiles.h"
+#include "broadphase.h"
+#include "stats.h"
 
 namespace iwemu
 {
@@ -11,46 +18,366 @@ namespace iwemu
 		// (solidScene will no longer process this object)
 		bool* alive = 0;
 		int grav_dir = 1;
+#ifdef IWEMU_STATS
+		// what the scene did in the last frames
+		StatsLog stats;
+#endif
 
+		// collidables is a slab of collidablesC boxes. the first liveC of them are in the scene,
+		// the rest is room for spawn(). all of them are in by default
 		SolidScene(
 			int grav_dir,
 			Hitbox* solids, size_t solidsC,
 			Segment* segments, size_t segmentsC,
-			BBox* collidables, size_t collidablesC
+			BBox* collidables, size_t collidablesC,
+			size_t liveC = (size_t)-1
+		);
+		// same, but static objects aren't indexed again: the index of shared is used.
+		// static solids and segments have to be the same as in shared
+		SolidScene(
+			const SolidScene& shared,
+			int grav_dir,
+			Hitbox* solids, size_t solidsC,
+			Segment* segments, size_t segmentsC,
+			BBox* collidables, size_t collidablesC,
+			size_t liveC = (size_t)-1
+		);
+		// on the solids and segments of a level, with the index it came with
+		SolidScene(
+			const Level& level,
+			int grav_dir,
+			BBox* collidables, size_t collidablesC,
+			size_t liveC = (size_t)-1
+		);
+		// on the chunks of a world near the collidables, see stream().
+		// the world has to live as long as the scene, and only one scene can be made on it
+		SolidScene(
+			World& world,
+			int grav_dir,
+			BBox* collidables, size_t collidablesC,
+			size_t liveC = (size_t)-1
 		);
 		~SolidScene();
+		// alive and the old boxes of collidables belong to the scene. another scene on the same room
+		// is made with the constructor that shares an index, on arrays of its own
+		SolidScene(const SolidScene&) = delete;
+		SolidScene& operator=(const SolidScene&) = delete;
+
+		// blocks of the tile layer are solids too, and never move. the layer is not copied,
+		// it has to live as long as the scene. 0 takes it away.
+		// when a tile is the closest thing, project_free_* gives no pointer to it
+		void set_tiles(const TileLayer* tiles);
+		const TileLayer* tiles() const { return this->_tiles; }
 
 		// tells if a specified place has any solid in it
 		bool place_solid(const Hitbox& hbox);
 		// tells if a wall or a solid intersect a box
 		bool place_free(const Hitbox& hbox);
+		// same for many boxes at once. the answer for hboxes[i] is bit i % 64 of dest[i / 64],
+		// dest has to have room for (hboxesC + 63) / 64 words. boxes are looked at in the order
+		// of the cells they are in, so each part of the room is read in one go, not once per box
+		void place_solid(const Hitbox* hboxes, size_t hboxesC, uint64_t* dest);
+		void place_free(const Hitbox* hboxes, size_t hboxesC, uint64_t* dest);
 
 		// tells how much box can be moved on a specified direction until it meets a solid
 		// optionally can tell what object is the closest
-		double project_free_left(const BBox& bbox, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
-		double project_free_up(const BBox& bbox, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
-		double project_free_right(const BBox& bbox, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
-		double project_free_down(const BBox& bbox, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
+		Scalar project_free_left(const BBox& bbox, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
+		Scalar project_free_up(const BBox& bbox, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
+		Scalar project_free_right(const BBox& bbox, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
+		Scalar project_free_down(const BBox& bbox, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
+		// same, but nothing farther than max is looked for. if the closest thing is farther than that,
+		// all that's known is that the answer is more than max (it can be infinity), and the pointers
+		// mean nothing. cheap for a box in the air, since the walk stops a cell or two away
+		Scalar project_free_left_within(const BBox& bbox, Scalar max, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
+		Scalar project_free_up_within(const BBox& bbox, Scalar max, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
+		Scalar project_free_right_within(const BBox& bbox, Scalar max, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
+		Scalar project_free_down_within(const BBox& bbox, Scalar max, Hitbox** hbox_p_dest=0, Segment** seg_p_dest=0);
+
+		// what a box moving by (dx, dy) runs into first
+		struct Hit
+		{
+			// part of the move done by then, in [0, 1). 1 if nothing is in the way
+			Scalar time;
+			// side of the thing that was hit, -1 or 1 on the axis the box stopped along: -1 for a wall
+			// on the right, since it faces left. both are set for a corner, both are 0 if the box is inside of it
+			int normal_x, normal_y;
+			// what it is. both are 0 for a tile, or if nothing is in the way
+			Hitbox* solid;
+			Segment* segment;
+		};
+		// box moves in a straight line. solids stop it from any side, segments only from the sides they block,
+		// and only if the box starts on that side. an axis the box doesn't move along is compared in pixels,
+		// like project_free_* does. things of zero width or height are never hit.
+		// of a few things hit at the same time, it's the solid with the lowest index, then a tile, then segments.
+		// it's a query for the game, update() moves collidables the way the fangame does instead
+		Hit sweep(const BBox& bbox, Scalar dx, Scalar dy);
 
 		enum class CollisionSide {
 			NONE, LEFT, TOP, RIGHT, BOTTOM
 		};
 		CollisionSide collision_side(const BBox& bbox, const Hitbox& hbox, int dx, int dy);
 
-		// moves every solid by desired amount, and pushes the collidables
+		// moves every solid by desired amount, and pushes the collidables.
+		// collidables it kills stay in the scene, since the game can revive them (a player that respawns),
+		// and later updates still go over them, skipping them. compact() has to be called to take them out
 		void update();
+
+		enum class Death {
+			NONE,
+			// pushed into the ground it was standing on
+			CRUSHED,
+			// ended up inside a solid
+			INSIDE_SOLID
+		};
+		static const int CONTACT_RANGE = 1;
+		// the closest thing on one side of a collidable
+		struct Side
+		{
+			// if it is CONTACT_RANGE or closer, infinity if it's farther. 0 or less is touching
+			Scalar dist;
+			// what it is. both are 0 for a tile, or if nothing is close
+			Hitbox* solid;
+			Segment* segment;
+		};
+		// what is right next to a collidable, and what happened to it in the last update()
+		struct Contact
+		{
+			// by Direction. a side is only found when it's asked for, once a frame
+			Side sides[4];
+			// bit per side that is found already
+			unsigned int known;
+			// mover the collidable stood on and was carried by, if any
+			Hitbox* carried_by_solid;
+			Segment* carried_by_segment;
+			// how it died. stays until it's alive again
+			Death death;
+		};
+		// contact of collidable k after the last update(). a side is what
+		// project_free_*_within(collidable, CONTACT_RANGE) tells, the first time it's asked for,
+		// and the same answer after that until the next update(). game logic asks every frame
+		// if the player stands on something, and this way it costs one short projection, or none.
+		// if the collidable was moved or revived by hand, refresh_contact() has to be called.
+		// dead collidables touch nothing
+		const Side& touching(size_t k, Direction side);
+		// all four sides
+		const Contact& contact(size_t k);
+		// forgets the sides of collidable k, so they are found again
+		void refresh_contact(size_t k);
+
+		// collidables come and go, bullets and such. the ones in the scene are always packed at the
+		// front of the slab, so every loop over them stops at collidable_count(). when one goes away,
+		// the last one takes its place, so indices change, but a handle stays the same
+		// for as long as the collidable is in the scene. nothing is allocated here
+		struct Handle
+		{
+			// place in the slab it was given, not the index
+			unsigned int slot;
+			// how many times the slot was freed before
+			unsigned int generation;
+		};
+		size_t collidable_count() const { return this->_collidableC; }
+		size_t collidable_capacity() const { return this->_collidableCapacity; }
+		// puts bbox in the scene, alive, at the end of the ones that are there.
+		// slot of the handle is ~0u if the slab is full
+		Handle spawn(const BBox& bbox);
+		// takes a collidable out of the scene. false if it is gone already
+		bool despawn(Handle handle);
+		// takes out every dead collidable, and tells how many there were. update() never does it,
+		// the game calls it when the dead ones won't come back, like once a frame for bullets
+		size_t compact();
+		// index of a collidable now, -1 if it is gone
+		long index_of(Handle handle) const;
+		Handle handle_of(size_t k) const;
+
+		// projectiles are bullets and such: nothing carries or pushes them, and they don't care about corners.
+		// each update(), after the collidables, they move by their speed, and the ones that touch a solid,
+		// a tile or a segment (from any side, like place_free tells) are taken out and put into the hits.
+		// they're kept as an array per field, so they're all moved in one tight loop,
+		// and tested in one batch query, cell after cell
+		struct ProjectileArrays
+		{
+			std::vector<Scalar> x, y, dx, dy;
+			std::vector<unsigned int> width, height;
+			// whatever the game wants to know them by
+			std::vector<unsigned int> tag;
+		};
+		struct ProjectileHit
+		{
+			unsigned int tag;
+			// where it was when it hit
+			Hitbox at;
+			// the one with the lowest index, like sweep() tells. both are 0 for a tile
+			Hitbox* solid;
+			Segment* segment;
+		};
+		// speed of bbox is its speed. index of the new one is projectile_count() - 1
+		void add_projectile(const BBox& bbox, unsigned int tag);
+		// the last one takes its place
+		void remove_projectile(size_t i);
+		size_t projectile_count() const { return this->_projectiles.tag.size(); }
+		const ProjectileArrays& projectiles() const { return this->_projectiles; }
+		// what was hit in the last update(), in the order of the projectiles before it
+		const ProjectileHit* projectile_hits() const { return this->_projectile_hits.data(); }
+		size_t projectile_hit_count() const { return this->_projectile_hits.size(); }
+
+		// everything update() can change: moving solids and segments, collidables, alive and grav_dir,
+		// which collidables are in the scene, and projectiles. hits of projectiles are not kept.
+		// solids and segments that don't move are never copied, so a snapshot
+		// is as big as movers and collidables are
+		struct Snapshot
+		{
+			std::vector<Hitbox> solids;
+			std::vector<Segment> segments;
+			std::vector<BBox> collidables;
+			std::vector<bool> alive;
+			std::vector<Contact> contacts;
+			// slot of every place in the slab, and generation of every slot
+			std::vector<unsigned int> slots;
+			std::vector<unsigned int> generations;
+			ProjectileArrays projectiles;
+			int grav_dir = 1;
+			// generation of the grid of the scene that saved it
+			uint64_t generation = 0;
+			// where solids and segments of that scene were, so pointers of contacts can be moved into another one.
+			// pointers to anything else (parts of merged objects, chunks of a world) aren't kept
+			const Hitbox* solids_base = 0;
+			const Segment* segments_base = 0;
+			size_t solidsC = 0, segmentsC = 0;
+		};
+		// snapshot is reused, so saving into the same one again doesn't allocate
+		void save(Snapshot& dest) const;
+		// puts the scene back to where it was on save(). the snapshot has to be saved after the last
+		// reindex() or stream() that changed chunks, by this scene or by one sharing its index,
+		// otherwise returns false and does nothing. a scene on a world calls stream() after it.
+		// sides of contacts found on something that isn't in the arrays of the scene are found again when they are asked for
+		bool restore(const Snapshot& snap);
+
+		// hash of what update() can change, the same things as in a snapshot but the speeds of movers:
+		// the game sets those, update() only moves by them. a different speed shows in the hash only once
+		// a mover has moved by it. the part of movers is kept up to date as update() and restore() move them,
+		// so only collidables and projectiles are hashed here. a mover put somewhere else by hand isn't seen
+		// until reindex(), which it needs anyway. same hash means the same state of all of that, not of the speeds
+		uint64_t state_hash() const;
+
+		// for a scene made on a world: picks the chunks near live collidables and projectiles,
+		// and if they aren't the ones the scene has, puts the new ones into the grid and takes out the ones
+		// that went. their grids were built when the world was written, so nothing is merged or indexed here,
+		// and the grid is only made again when it has to span other chunks. update() does it first thing.
+		// when a collidable is moved far by hand (respawned), it has to be called before the scene is asked
+		// about it, same as refresh_contact(). true if the chunks changed: then pointers to objects of chunks
+		// that went are no good any more, and the index is new, so older snapshots can't be restored
+		bool stream();
+
+		// solids and segments are indexed on construction. if they were moved
+		// by anything other than update(), or a standing one got a speed,
+		// index has to be rebuilt
+		void reindex();
 	private:
 		Hitbox* _solids = 0;
 		size_t _solidsC = 0;
 		Segment* _segments = 0;
 		size_t _segmentsC = 0;
 		BBox* _collidable = 0;
+		// how many are in the scene, and how many fit in the slab
 		size_t _collidableC = 0;
+		size_t _collidableCapacity = 0;
+		// slot of every place in the slab, place of every slot, and generation of every slot.
+		// free slots are the ones past _collidableC
+		std::vector<unsigned int> _slots;
+		std::vector<unsigned int> _slot_index;
+		std::vector<unsigned int> _generations;
 		BBox* _collidableOld = 0;
+		SolidGrid _grid;
+		const TileLayer* _tiles = 0;
+		World* _world = 0;
+		// chunks the grid is over
+		World::ChunkRange _chunks = { 0, 0, -1, -1 };
+		// scratch space of stream(), boxes chunks are picked around
+		std::vector<Hitbox> _stream_areas;
+		// indices of solids and segments that move. only these are carrying and pushing
+		std::vector<unsigned int> _moving_solids;
+		std::vector<unsigned int> _moving_segments;
+		// sum of mover_hash() of every mover at where it is now
+		uint64_t _movers_hash = 0;
+		// which collidables every mover can reach this frame.
+		// moving solids come first, then moving segments
+		Broadphase _broadphase;
+		// boxes collidables were paired with
+		std::vector<Hitbox> _collidable_reach;
+		// if a collidable got moved out of its box, every mover after that checks everyone
+		bool _escaped = false;
+		std::vector<unsigned int> _all_collidables;
+		// scratch space of update(). which movers are already moved, and which collidables stand on something
+		std::vector<bool> _done;
+		std::vector<bool> _standing;
+		std::vector<Contact> _contacts;
+		ProjectileArrays _projectiles;
+		std::vector<ProjectileHit> _projectile_hits;
+		// scratch space of move_projectiles(). boxes projectiles fly over, and which ones are free
+		std::vector<Hitbox> _projectile_boxes;
+		std::vector<uint64_t> _projectile_free;
+		// scratch space of batch queries: bin of every box, where bins start,
+		// and boxes bin after bin with their index in the query
+		std::vector<unsigned int> _batch_bin;
+		std::vector<unsigned int> _batch_offsets;
+		std::vector<Hitbox> _batch_boxes;
+		std::vector<unsigned int> _batch_order;
+
+		// what both constructors do before indexing
+		void init();
+		// makes the grid over the chunks the world has indexed, and puts them in
+		void index_chunks();
+		// puts chunk c of the world into its block of the grid, or takes it out if it isn't indexed
+		void set_chunk(unsigned int c);
+		// takes collidable k out, which has to be in the scene
+		void despawn_at(size_t k);
+		// finds moving objects, and makes scratch space for them
+		void find_movers();
+		// sums the hashes of movers from scratch, when they were put somewhere without moving them
+		void hash_movers();
+		// moves mover m of _moving_solids (or _moving_segments), and its part of the hash
+		void move_solid(size_t m, int dx, int dy);
+		void move_segment(size_t m, int dx, int dy);
+		bool solid_in(const SolidGrid::Cell& cell, const Hitbox& hbox);
+		bool segment_in(const SolidGrid::Cell& cell, const Hitbox& hbox);
+		const unsigned int* candidates(unsigned int mover, size_t& count);
+		void track_escape(size_t k);
+		void sort_batch(const Hitbox* hboxes, size_t hboxesC);
+		// place_free with solids and segments looked at in the same pass over the cells
+		bool free_at(const Hitbox& hbox);
+		// is bbox standing on a solid that never moves
+		bool standing_on_static(const BBox& bbox);
+		// forgets the sides of every collidable
+		void refresh_contacts();
+
+		// solids, segments and tiles near a box, found by gather() in one pass over the cells.
+		// solids and segments are by address, lowest first, the order they win ties in
+		std::vector<Hitbox*> _near_solids;
+		std::vector<Segment*> _near_segments;
+		std::vector<Hitbox> _near_tiles;
+		// finds everything that can intersect area, or everything there is if all
+		void gather(const Hitbox& area, bool all);
+		// place_solid, place_free and project_free_* on what gather() found
+		bool near_solid(const Hitbox& hbox) const;
+		bool near_free(const Hitbox& hbox) const;
+		template <
+			Scalar (*project_function_hbox)(const BBox&, const Hitbox&),
+			Scalar (*project_function_seg)(const BBox&, const Segment&)
+		>
+		Scalar near_distance(const BBox& bbox) const;
+		// moves a collidable by its speed the way fangames do. false if it was inside a solid
+		bool move_collidable(BBox& cc);
+		// moves projectiles, and takes out the ones that hit something on the way
+		void move_projectiles();
 
-		double project_free_direction(const BBox& bbox, Hitbox** hbox_p_dest, Segment** seg_p_dest,
-			double (*project_function_hbox)(const BBox&, const Hitbox&),
-			double (*project_function_seg)(const BBox&, const Segment&));
+		// walks the grid cells in the direction of projection, row (or column) of cells at a time,
+		// and stops as soon as nothing in the cells left can be closer than what was found already, or than max
+		template <
+			Scalar (*project_function_hbox)(const BBox&, const Hitbox&),
+			Scalar (*project_function_seg)(const BBox&, const Segment&),
+			bool horizontal, int step
+		>
+		Scalar project_free_direction(const BBox& bbox, Scalar max, Hitbox** hbox_p_dest, Segment** seg_p_dest);
 
 	};
 }
@@ -0,0 +1,54 @@
+#include "stats.h"
+
+namespace iwemu
+{
+	StatsLog::StatsLog(size_t capacity)
+	{
+		this->_frames.resize(capacity ? capacity : 1);
+	}
+
+	void StatsLog::end_frame()
+	{
+		this->_frames[this->_next] = this->_current;
+		this->_next = (this->_next + 1) % this->_frames.size();
+		if (this->_size < this->_frames.size()) this->_size++;
+		unsigned long long frame = this->_current.frame + 1;
+		this->_current = {};
+		this->_current.frame = frame;
+	}
+
+	const FrameStats& StatsLog::at(size_t i) const
+	{
+		size_t oldest = (this->_next + this->_frames.size() - this->_size) % this->_frames.size();
+		return this->_frames[(oldest + i) % this->_frames.size()];
+	}
+
+	void StatsLog::clear()
+	{
+		this->_next = 0;
+		this->_size = 0;
+		this->_current = {};
+	}
+
+	void StatsLog::write_csv(FILE* f) const
+	{
+		fprintf(f,
+			"frame,place_solid,place_free,project_free,intersect,project,carries,pushes,deaths,projectile_hits,chunk_reads,"
+			"streaming_ns,pairing_ns,carry_solids_ns,carry_segments_ns,standing_ns,push_solids_ns,push_segments_ns,movement_ns,projectiles_ns\n");
+		for (size_t i = 0; i < this->_size; i++)
+		{
+			const FrameStats& s = this->at(i);
+			fprintf(f, "%llu,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+				s.frame, s.place_solids, s.place_frees, s.projections, s.intersects, s.project_tests,
+				s.carries, s.pushes, s.deaths, s.projectile_hits, s.chunk_reads,
+				s.streaming_ns, s.pairing_ns, s.carry_solids_ns, s.carry_segments_ns, s.standing_ns,
+				s.push_solids_ns, s.push_segments_ns, s.movement_ns, s.projectiles_ns);
+		}
+	}
+
+	void StatsLog::write_binary(FILE* f) const
+	{
+		for (size_t i = 0; i < this->_size; i++)
+			fwrite(&this->at(i), sizeof(FrameStats), 1, f);
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+// SolidScene only counts anything when built with IWEMU_STATS defined.
+// without it the counters below are never touched and cost nothing
+#ifdef IWEMU_STATS
+#include <chrono>
+#define IWEMU_COUNT(field) (this->stats.current().field++)
+#define IWEMU_COUNT_N(field, n) (this->stats.current().field += (unsigned int)(n))
+#else
+#define IWEMU_COUNT(field) ((void)0)
+#define IWEMU_COUNT_N(field, n) ((void)0)
+#endif
+
+namespace iwemu
+{
+	// what a scene did during one frame: from the end of one update() to the end of the next,
+	// so queries of the game logic count towards the update() that follows them
+	struct FrameStats
+	{
+		unsigned long long frame;
+		// calls. place_free calls place_solid as well
+		unsigned int place_solids, place_frees, projections;
+		// intersect() and project_*() against single objects, done by the calls above
+		unsigned int intersects, project_tests;
+		unsigned int carries, pushes, deaths, projectile_hits;
+		// chunks of a world read from the file
+		unsigned int chunk_reads;
+		// ns spent in each part of update()
+		unsigned long long streaming_ns, pairing_ns;
+		unsigned long long carry_solids_ns, carry_segments_ns;
+		unsigned long long standing_ns;
+		unsigned long long push_solids_ns, push_segments_ns;
+		unsigned long long movement_ns, projectiles_ns;
+	};
+
+	// last frames, oldest are overwritten
+	class StatsLog
+	{
+	public:
+		StatsLog(size_t capacity = 600);
+
+		FrameStats& current() { return this->_current; }
+		// stores current frame, and starts a new one
+		void end_frame();
+
+		size_t size() const { return this->_size; }
+		// i = 0 is the oldest frame kept
+		const FrameStats& at(size_t i) const;
+		void clear();
+
+		// header line, and a line per frame, oldest first
+		void write_csv(FILE* f) const;
+		// FrameStats as they are in memory, oldest first
+		void write_binary(FILE* f) const;
+
+	private:
+		std::vector<FrameStats> _frames;
+		size_t _next = 0;
+		size_t _size = 0;
+		FrameStats _current = {};
+	};
+
+#ifdef IWEMU_STATS
+	// wall time since the last lap, added to a field
+	class PhaseClock
+	{
+	public:
+		PhaseClock() : _t(std::chrono::steady_clock::now()) {}
+		void lap(unsigned long long& ns)
+		{
+			std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+			ns += (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(t - this->_t).count();
+			this->_t = t;
+		}
+	private:
+		std::chrono::steady_clock::time_point _t;
+	};
+#define IWEMU_PHASE(clock) PhaseClock clock
+#define IWEMU_LAP(clock, field) clock.lap(this->stats.current().field)
+#else
+#define IWEMU_PHASE(clock) ((void)0)
+#define IWEMU_LAP(clock, field) ((void)0)
+#endif
+}
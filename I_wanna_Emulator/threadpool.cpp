@@ -0,0 +1,90 @@
+#include "threadpool.h"
+
+namespace iwemu
+{
+	ThreadPool::ThreadPool(unsigned int threads)
+	{
+		if (threads == 0) threads = std::thread::hardware_concurrency();
+		if (threads == 0) threads = 1;
+		this->_partsC = threads;
+		this->_parts.reset(new Part[threads]);
+		for (unsigned int w = 0; w < threads; w++)
+		{
+			this->_parts[w].next = 0;
+			this->_parts[w].end = 0;
+		}
+		for (unsigned int w = 1; w < threads; w++)
+			this->_threads.push_back(std::thread(&ThreadPool::worker, this, (size_t)w));
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_stop = true;
+		}
+		this->_wake.notify_all();
+		for (size_t t = 0; t < this->_threads.size(); t++)
+			this->_threads[t].join();
+	}
+
+	void ThreadPool::run(size_t count, const std::function<void(size_t)>& job)
+	{
+		this->run(count, [&job](size_t i, unsigned int) { job(i); });
+	}
+
+	void ThreadPool::run(size_t count, const std::function<void(size_t, unsigned int)>& job)
+	{
+		size_t n = this->_partsC;
+		for (size_t w = 0; w < n; w++)
+		{
+			this->_parts[w].next = count * w / n;
+			this->_parts[w].end = count * (w + 1) / n;
+		}
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_job = &job;
+			this->_working = n - 1;
+			this->_generation++;
+		}
+		this->_wake.notify_all();
+		this->work(0);
+
+		std::unique_lock<std::mutex> lock(this->_mutex);
+		this->_finished.wait(lock, [this] { return this->_working == 0; });
+		this->_job = 0;
+	}
+
+	void ThreadPool::worker(size_t w)
+	{
+		unsigned long long seen = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(this->_mutex);
+				this->_wake.wait(lock, [&] { return this->_stop || this->_generation != seen; });
+				if (this->_stop) return;
+				seen = this->_generation;
+			}
+			this->work(w);
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			if (--this->_working == 0) this->_finished.notify_one();
+		}
+	}
+
+	void ThreadPool::work(size_t w)
+	{
+		// own part first, then whatever is left in the parts of the others
+		size_t n = this->_partsC;
+		for (size_t k = 0; k < n; k++)
+		{
+			Part& part = this->_parts[(w + k) % n];
+			for (;;)
+			{
+				size_t i = part.next.fetch_add(1);
+				if (i >= part.end) break;
+				(*this->_job)(i, (unsigned int)w);
+			}
+		}
+	}
+}
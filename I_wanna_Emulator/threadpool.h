@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace iwemu
+{
+	// threads that wait for jobs. run() splits [0, count) into a part for every thread,
+	// a thread that finished its own part takes items from the parts of others
+	class ThreadPool
+	{
+	public:
+		// 0 - as many as there are cores. the thread calling run() counts as one
+		ThreadPool(unsigned int threads = 0);
+		~ThreadPool();
+
+		unsigned int size() const { return this->_partsC; }
+		// calls job(i) for every i in [0, count), returns when all of them are done
+		void run(size_t count, const std::function<void(size_t)>& job);
+		// same, and tells which thread it is, in [0, size())
+		void run(size_t count, const std::function<void(size_t i, unsigned int thread)>& job);
+
+	private:
+		// items of a thread are [next, end). padded, so threads taking items
+		// from their parts don't fight over a cache line
+		struct Part
+		{
+			char before[64];
+			std::atomic<size_t> next;
+			size_t end;
+			char after[64];
+		};
+
+		std::vector<std::thread> _threads;
+		std::unique_ptr<Part[]> _parts;
+		unsigned int _partsC;
+		const std::function<void(size_t, unsigned int)>* _job = 0;
+
+		std::mutex _mutex;
+		std::condition_variable _wake;
+		std::condition_variable _finished;
+		unsigned long long _generation = 0;
+		size_t _working = 0;
+		bool _stop = false;
+
+		void worker(size_t w);
+		void work(size_t w);
+	};
+}
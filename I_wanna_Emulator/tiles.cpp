@@ -0,0 +1,189 @@
+#include "tiles.h"
+
+#include <algorithm>
+#include "bits.h"
+
+namespace iwemu
+{
+	// is any bit in [from, to] of a line set
+	static bool any_in(const uint64_t* line, int from, int to)
+	{
+		for (int w = from / 64; w <= to / 64; w++)
+		{
+			uint64_t bits = line[w];
+			if (w == from / 64) bits &= ~(uint64_t)0 << (from % 64);
+			if (w == to / 64 && to % 64 != 63) bits &= ((uint64_t)1 << (to % 64 + 1)) - 1;
+			if (bits) return true;
+		}
+		return false;
+	}
+
+	// last set bit at or before to in a line, -1 if none
+	static int last_in(const uint64_t* line, int to)
+	{
+		for (int w = to / 64; w >= 0; w--)
+		{
+			uint64_t bits = line[w];
+			if (w == to / 64 && to % 64 != 63) bits &= ((uint64_t)1 << (to % 64 + 1)) - 1;
+			if (bits) return w * 64 + high_bit(bits);
+		}
+		return -1;
+	}
+
+	// first set bit at or after from in a line of count bits, -1 if none
+	static int first_in(const uint64_t* line, int from, int count)
+	{
+		for (int w = from / 64; w * 64 < count; w++)
+		{
+			uint64_t bits = line[w];
+			if (w == from / 64) bits &= ~(uint64_t)0 << (from % 64);
+			if (bits) return w * 64 + low_bit(bits);
+		}
+		return -1;
+	}
+
+	TileLayer::TileLayer(int x, int y, int cols, int rows, int tile_size)
+		: _x(x), _y(y), _cols(cols), _rows(rows), _tile_size(tile_size)
+	{
+		this->_row_words = ((size_t)cols + 63) / 64;
+		this->_col_words = ((size_t)rows + 63) / 64;
+		this->_by_row.assign(this->_row_words * rows, 0);
+		this->_by_col.assign(this->_col_words * cols, 0);
+	}
+
+	void TileLayer::set(int col, int row, bool solid)
+	{
+		uint64_t& r = this->_by_row[row * this->_row_words + col / 64];
+		uint64_t& c = this->_by_col[col * this->_col_words + row / 64];
+		uint64_t rbit = (uint64_t)1 << (col % 64), cbit = (uint64_t)1 << (row % 64);
+		if (((r & rbit) != 0) == solid) return;
+		r ^= rbit;
+		c ^= cbit;
+		if (solid) this->_count++;
+		else this->_count--;
+	}
+
+	bool TileLayer::get(int col, int row) const
+	{
+		return (this->_by_row[row * this->_row_words + col / 64] >> (col % 64)) & 1;
+	}
+
+	Hitbox TileLayer::tile(int col, int row) const
+	{
+		unsigned int s = (unsigned int)this->_tile_size;
+		return { this->_x + col * this->_tile_size, this->_y + row * this->_tile_size, s, s, 0, 0 };
+	}
+
+	bool TileLayer::span(int from, unsigned int length, int origin, int count, int64_t& first, int64_t& last) const
+	{
+		// tile t is intersected if origin + t * size < from + length and from < origin + (t + 1) * size,
+		// the same as intersect() tells
+		first = floor_div((int64_t)from - origin, this->_tile_size);
+		last = floor_div((int64_t)from + (int64_t)length - 1 - origin, this->_tile_size);
+		return std::max(first, (int64_t)0) <= std::min(last, (int64_t)count - 1);
+	}
+
+	bool TileLayer::intersects(const Hitbox& hbox) const
+	{
+		int64_t c1, c2, r1, r2;
+		if (!this->span(hbox.x, hbox.width, this->_x, this->_cols, c1, c2) ||
+			!this->span(hbox.y, hbox.height, this->_y, this->_rows, r1, r2))
+			return false;
+		int from = (int)std::max(c1, (int64_t)0), to = (int)std::min(c2, (int64_t)this->_cols - 1);
+		for (int64_t row = std::max(r1, (int64_t)0); row <= r2 && row < this->_rows; row++)
+		{
+			if (any_in(this->_by_row.data() + row * this->_row_words, from, to))
+				return true;
+		}
+		return false;
+	}
+
+	bool TileLayer::intersects_except(const Hitbox& hbox, const Hitbox& other) const
+	{
+		int64_t c1, c2, r1, r2;
+		if (!this->span(hbox.x, hbox.width, this->_x, this->_cols, c1, c2) ||
+			!this->span(hbox.y, hbox.height, this->_y, this->_rows, r1, r2))
+			return false;
+		for (int64_t row = std::max(r1, (int64_t)0); row <= r2 && row < this->_rows; row++)
+		{
+			for (int64_t col = std::max(c1, (int64_t)0); col <= c2 && col < this->_cols; col++)
+			{
+				if (this->get((int)col, (int)row) && !intersect(other, this->tile((int)col, (int)row)))
+					return true;
+			}
+		}
+		return false;
+	}
+
+	int TileLayer::nearest(Direction dir, const Hitbox& hbox, int limit, Hitbox* dest) const
+	{
+		bool horizontal = dir == Direction::LEFT || dir == Direction::RIGHT;
+		bool back = dir == Direction::LEFT || dir == Direction::UP;
+		// "along" is the axis of projection, "across" is the other one.
+		// lines are rows for horizontal projections, and columns for vertical ones
+		int along_origin = horizontal ? this->_x : this->_y, along_count = horizontal ? this->_cols : this->_rows;
+		int across_origin = horizontal ? this->_y : this->_x, across_count = horizontal ? this->_rows : this->_cols;
+		int64_t a1, a2, c1, c2;
+		if (!this->span(horizontal ? hbox.y : hbox.x, horizontal ? hbox.height : hbox.width, across_origin, across_count, c1, c2))
+			return 0;
+		c1 = std::max(c1, (int64_t)0);
+		c2 = std::min(c2, (int64_t)across_count - 1);
+		const uint64_t* bits = horizontal ? this->_by_row.data() : this->_by_col.data();
+		size_t words = horizontal ? this->_row_words : this->_col_words;
+		int found = 0;
+
+		// tiles in [a1, a2] intersect the box
+		bool along = this->span(horizontal ? hbox.x : hbox.y, horizontal ? hbox.width : hbox.height, along_origin, along_count, a1, a2);
+		if (along)
+		{
+			int from = (int)std::max(a1, (int64_t)0), to = (int)std::min(a2, (int64_t)along_count - 1);
+			for (int64_t line = c1; line <= c2; line++)
+			{
+				int t = first_in(bits + line * words, from, to + 1);
+				if (t < 0 || t > to) continue;
+				dest[found++] = horizontal ? this->tile(t, (int)line) : this->tile((int)line, t);
+				break;
+			}
+		}
+
+		// the ones in the way are past limit, and out of [a1, a2]
+		int64_t t0 = back ?
+			floor_div((int64_t)limit - along_origin, this->_tile_size) :
+			-floor_div((int64_t)along_origin - limit, this->_tile_size);
+		if (a1 <= a2)
+			t0 = back ? std::min(t0, a1 - 1) : std::max(t0, a2 + 1);
+		if (back ? t0 < 0 : t0 >= along_count)
+			return found;
+		int from = (int)(back ? std::min(t0, (int64_t)along_count - 1) : std::max(t0, (int64_t)0));
+		int best = -1, best_line = 0;
+		for (int64_t line = c1; line <= c2; line++)
+		{
+			const uint64_t* l = bits + line * words;
+			int t = back ? last_in(l, from) : first_in(l, from, along_count);
+			if (t >= 0 && (best < 0 || (back ? t > best : t < best)))
+			{
+				best = t;
+				best_line = (int)line;
+			}
+		}
+		if (best >= 0)
+			dest[found++] = horizontal ? this->tile(best, best_line) : this->tile(best_line, best);
+		return found;
+	}
+
+	void split_tiles(TileLayer& layer, const Hitbox* solids, size_t solidsC, std::vector<Hitbox>& rest)
+	{
+		int size = layer.tile_size();
+		for (size_t i = 0; i < solidsC; i++)
+		{
+			const Hitbox& s = solids[i];
+			int64_t col = floor_div((int64_t)s.x - layer.x(), size), row = floor_div((int64_t)s.y - layer.y(), size);
+			if (s.dx == 0 && s.dy == 0 && s.width == (unsigned int)size && s.height == (unsigned int)size &&
+				(s.x - layer.x()) % size == 0 && (s.y - layer.y()) % size == 0 &&
+				col >= 0 && col < layer.cols() && row >= 0 && row < layer.rows())
+				layer.set((int)col, (int)row, true);
+			else
+				rest.push_back(s);
+		}
+	}
+}
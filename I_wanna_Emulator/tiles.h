@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "hitbox.h"
+#include "kernels.h"
+
+namespace iwemu
+{
+	// blocks aligned to a grid, as one bit per tile. most of a fangame room is that,
+	// and a bit is a lot less to look at than a Hitbox.
+	// tile (col, row) is the box { x + col * tile_size, y + row * tile_size, tile_size, tile_size }.
+	// bits are kept both row after row and column after column, so a scan along either axis reads whole words
+	class TileLayer
+	{
+	public:
+		static const int DEFAULT_TILE_SIZE = 32;
+
+		TileLayer(int x = 0, int y = 0, int cols = 0, int rows = 0, int tile_size = DEFAULT_TILE_SIZE);
+
+		void set(int col, int row, bool solid);
+		bool get(int col, int row) const;
+		Hitbox tile(int col, int row) const;
+		// number of solid tiles
+		size_t count() const { return this->_count; }
+
+		int x() const { return this->_x; }
+		int y() const { return this->_y; }
+		int cols() const { return this->_cols; }
+		int rows() const { return this->_rows; }
+		int tile_size() const { return this->_tile_size; }
+
+		// is there a solid tile intersecting hbox
+		bool intersects(const Hitbox& hbox) const;
+		// is there a solid tile intersecting hbox, but not other
+		bool intersects_except(const Hitbox& hbox, const Hitbox& other) const;
+		// the only tiles project_* can give the smallest distance for, same as nearest_boxes() does for
+		// a run of boxes: one that intersects the collidable, and the closest one in the way of it.
+		// hbox is the collidable rounded to pixels, and tiles are in the direction if their x (or y)
+		// is <= limit for left and up, >= limit for right and down.
+		// dest has room for two, returns how many were found
+		int nearest(Direction dir, const Hitbox& hbox, int limit, Hitbox* dest) const;
+
+	private:
+		int _x, _y;
+		int _cols, _rows;
+		int _tile_size;
+		size_t _count = 0;
+		// bit col of row row is bit col % 64 of _by_row[row * _row_words + col / 64]
+		size_t _row_words;
+		std::vector<uint64_t> _by_row;
+		// and the same transposed
+		size_t _col_words;
+		std::vector<uint64_t> _by_col;
+
+		// inclusive range of columns (or rows) that a span of pixels intersects, false if none.
+		// first and last are not clamped to the layer
+		bool span(int from, unsigned int length, int origin, int count, int64_t& first, int64_t& last) const;
+	};
+
+	// moves the solids that are exactly a tile of the layer and never move into it.
+	// the rest of them is put into rest, in the same order
+	void split_tiles(TileLayer& layer, const Hitbox* solids, size_t solidsC, std::vector<Hitbox>& rest);
+}
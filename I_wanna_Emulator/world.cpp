@@ -0,0 +1,454 @@
+#include "world.h"
+
+#include <string.h>
+#include <algorithm>
+#include "bits.h"
+#include "grid.h"
+
+namespace iwemu
+{
+	static const char WORLD_MAGIC[4] = { 'I', 'W', 'W', 'D' };
+	static const uint32_t WORLD_BYTE_ORDER = 0x01020304;
+
+	// then moving solids, moving segments, collidables, a ChunkEntry per chunk row after row,
+	// and the level of every chunk with something in it
+	struct WorldHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t byte_order;
+		uint32_t hitbox_size, segment_size;
+		int32_t chunk_size, x, y, cols, rows;
+		uint64_t moving_solidsC, moving_segmentsC, collidablesC;
+	};
+
+	struct ChunkEntry
+	{
+		uint64_t offset, size;
+		int32_t x, y, right, bottom;
+	};
+
+	// levels start this far apart, like the arrays in them
+	static const uint64_t CHUNK_ALIGN = 64;
+
+	static bool seek(FILE* f, uint64_t offset)
+	{
+#ifdef _WIN32
+		return _fseeki64(f, (long long)offset, SEEK_SET) == 0;
+#else
+		return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+	}
+
+	static bool tell(FILE* f, uint64_t& dest)
+	{
+#ifdef _WIN32
+		long long at = _ftelli64(f);
+#else
+		long long at = (long long)ftello(f);
+#endif
+		if (at < 0) return false;
+		dest = (uint64_t)at;
+		return true;
+	}
+
+	static bool file_size(FILE* f, uint64_t& dest)
+	{
+#ifdef _WIN32
+		if (_fseeki64(f, 0, SEEK_END) != 0) return false;
+#else
+		if (fseeko(f, 0, SEEK_END) != 0) return false;
+#endif
+		return tell(f, dest);
+	}
+
+	template <typename T>
+	static bool read_array(FILE* f, std::vector<T>& dest, uint64_t count)
+	{
+		dest.resize((size_t)count);
+		return count == 0 || fread(dest.data(), sizeof(T), (size_t)count, f) == count;
+	}
+
+	template <typename T>
+	static bool write_array(FILE* f, const T* data, size_t count)
+	{
+		return count == 0 || fwrite(data, sizeof(T), count, f) == count;
+	}
+
+	// what an object takes, at least a pixel each way, so things without a size are somewhere too
+	static Hitbox extent(const Hitbox& hbox)
+	{
+		return { hbox.x, hbox.y, std::max(hbox.width, 1u), std::max(hbox.height, 1u), 0, 0 };
+	}
+
+	static Hitbox extent(const Segment& seg)
+	{
+		unsigned int length = std::max(seg.length, 1u);
+		return { seg.x, seg.y, seg.vertical ? 1u : length, seg.vertical ? length : 1u, 0, 0 };
+	}
+
+	bool write_world(FILE* f, const Hitbox* solids, size_t solidsC, const Segment* segments, size_t segmentsC,
+		const Hitbox* collidables, size_t collidablesC, int chunk_size)
+	{
+		const int cell_size = SolidGrid::DEFAULT_CELL_SIZE;
+		if (chunk_size <= 0 || chunk_size % cell_size != 0) return false;
+		WorldHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, WORLD_MAGIC, 4);
+		header.version = WORLD_VERSION;
+		header.byte_order = WORLD_BYTE_ORDER;
+		header.hitbox_size = sizeof(Hitbox);
+		header.segment_size = sizeof(Segment);
+		header.chunk_size = chunk_size;
+		header.collidablesC = collidablesC;
+
+		// static solids, then static segments, by what they take
+		std::vector<Hitbox> boxes;
+		std::vector<size_t> static_solids, static_segments;
+		std::vector<Hitbox> moving_solids;
+		std::vector<Segment> moving_segments;
+		for (size_t i = 0; i < solidsC; i++)
+		{
+			if (moving(solids[i])) moving_solids.push_back(solids[i]);
+			else
+			{
+				static_solids.push_back(i);
+				boxes.push_back(extent(solids[i]));
+			}
+		}
+		for (size_t i = 0; i < segmentsC; i++)
+		{
+			if (moving(segments[i])) moving_segments.push_back(segments[i]);
+			else
+			{
+				static_segments.push_back(i);
+				boxes.push_back(extent(segments[i]));
+			}
+		}
+		header.moving_solidsC = moving_solids.size();
+		header.moving_segmentsC = moving_segments.size();
+		// chunks are on a grid of their size, so cells of every chunk are on the same grid too
+		long long x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+		for (size_t b = 0; b < boxes.size(); b++)
+		{
+			long long right = (long long)boxes[b].x + boxes[b].width, bottom = (long long)boxes[b].y + boxes[b].height;
+			x1 = b ? std::min(x1, (long long)boxes[b].x) : boxes[b].x;
+			y1 = b ? std::min(y1, (long long)boxes[b].y) : boxes[b].y;
+			x2 = b ? std::max(x2, right) : right;
+			y2 = b ? std::max(y2, bottom) : bottom;
+		}
+		header.x = (int)floor_div(x1, chunk_size) * chunk_size;
+		header.y = (int)floor_div(y1, chunk_size) * chunk_size;
+		header.cols = std::max((int)floor_div(x2 - 1 - header.x, chunk_size) + 1, 1);
+		header.rows = std::max((int)floor_div(y2 - 1 - header.y, chunk_size) + 1, 1);
+		size_t chunksC = (size_t)header.cols * header.rows;
+
+		// objects of every chunk they touch, in the order they were in: where each chunk starts, then the list
+		std::vector<size_t> starts(chunksC + 1, 0), members;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			std::vector<size_t> fill(starts.begin(), starts.end() - 1);
+			for (size_t b = 0; b < boxes.size(); b++)
+			{
+				const Hitbox& box = boxes[b];
+				int col1 = (int)floor_div((long long)box.x - header.x, chunk_size);
+				int col2 = (int)floor_div((long long)box.x + box.width - 1 - header.x, chunk_size);
+				int row1 = (int)floor_div((long long)box.y - header.y, chunk_size);
+				int row2 = (int)floor_div((long long)box.y + box.height - 1 - header.y, chunk_size);
+				for (int row = row1; row <= row2; row++)
+				{
+					for (int col = col1; col <= col2; col++)
+					{
+						size_t c = (size_t)row * header.cols + col;
+						if (pass == 0) starts[c + 1]++;
+						else members[fill[c]++] = b;
+					}
+				}
+			}
+			if (pass == 0)
+			{
+				for (size_t c = 0; c < chunksC; c++)
+					starts[c + 1] += starts[c];
+				members.resize(starts[chunksC]);
+			}
+		}
+
+		uint64_t entries_at = 0;
+		std::vector<ChunkEntry> entries(chunksC);
+		if (fwrite(&header, sizeof(header), 1, f) != 1) return false;
+		if (!write_array(f, moving_solids.data(), moving_solids.size()) || !write_array(f, moving_segments.data(), moving_segments.size()) ||
+			!write_array(f, collidables, collidablesC) || !tell(f, entries_at) || !write_array(f, entries.data(), chunksC))
+			return false;
+		// levels are made one at a time, and the entries are written again once it's known where they are
+		static const char zeros[CHUNK_ALIGN] = {};
+		std::vector<Hitbox> chunk_solids;
+		std::vector<Segment> chunk_segments;
+		for (size_t c = 0; c < chunksC; c++)
+		{
+			ChunkEntry& e = entries[c];
+			if (starts[c] == starts[c + 1]) continue;
+			int cx = header.x + (int)(c % header.cols) * chunk_size, cy = header.y + (int)(c / header.cols) * chunk_size;
+			chunk_solids.clear();
+			chunk_segments.clear();
+			e.x = cx + chunk_size;
+			e.y = cy + chunk_size;
+			e.right = cx;
+			e.bottom = cy;
+			for (size_t k = starts[c]; k < starts[c + 1]; k++)
+			{
+				size_t b = members[k];
+				const Hitbox& box = boxes[b];
+				if (b < static_solids.size()) chunk_solids.push_back(solids[static_solids[b]]);
+				else chunk_segments.push_back(segments[static_segments[b - static_solids.size()]]);
+				// only the part in the square counts, the rest is in other chunks
+				e.x = std::min(e.x, std::max(box.x, cx));
+				e.y = std::min(e.y, std::max(box.y, cy));
+				e.right = std::max(e.right, (int)std::min((long long)box.x + box.width, (long long)cx + chunk_size));
+				e.bottom = std::max(e.bottom, (int)std::min((long long)box.y + box.height, (long long)cy + chunk_size));
+			}
+			Level level;
+			level.solids = chunk_solids.data();
+			level.solidsC = chunk_solids.size();
+			level.segments = chunk_segments.data();
+			level.segmentsC = chunk_segments.size();
+			level.grid = SolidGrid(cell_size);
+			level.grid.build(level.solids, level.solidsC, level.segments, level.segmentsC,
+				{ cx, cy, (unsigned int)chunk_size, (unsigned int)chunk_size, 0, 0 });
+			// a chunk too big for the grid would have bigger cells than the scene
+			if (level.grid.cell_size() != cell_size) return false;
+			uint64_t at = 0, end = 0;
+			if (!tell(f, at)) return false;
+			size_t pad = (size_t)((CHUNK_ALIGN - at % CHUNK_ALIGN) % CHUNK_ALIGN);
+			if (pad && fwrite(zeros, 1, pad, f) != pad) return false;
+			if (!write_level(f, level) || !tell(f, end)) return false;
+			e.offset = at + pad;
+			e.size = end - e.offset;
+		}
+		return seek(f, entries_at) && write_array(f, entries.data(), chunksC) && fflush(f) == 0;
+	}
+
+	World::~World()
+	{
+		this->close();
+	}
+
+	void World::close()
+	{
+		if (this->_file) fclose(this->_file);
+		this->_file = 0;
+		this->_collidables.clear();
+		this->_solids.clear();
+		this->_segments.clear();
+		this->_chunks.clear();
+		this->_indexed.clear();
+		this->_changed.clear();
+		this->_unused.clear();
+		this->_range = {};
+		this->_unused_bytes = 0;
+		this->_loaded = this->_bytes = this->_reads = 0;
+		this->_failed = false;
+	}
+
+	bool World::open(const char* path)
+	{
+		this->close();
+		FILE* f = fopen(path, "rb");
+		if (!f) return false;
+		WorldHeader header;
+		uint64_t size = 0;
+		bool ok = file_size(f, size) && seek(f, 0) && fread(&header, sizeof(header), 1, f) == 1 &&
+			memcmp(header.magic, WORLD_MAGIC, 4) == 0 && header.version == WORLD_VERSION &&
+			header.byte_order == WORLD_BYTE_ORDER &&
+			header.hitbox_size == sizeof(Hitbox) && header.segment_size == sizeof(Segment) &&
+			header.chunk_size > 0 && header.chunk_size % SolidGrid::DEFAULT_CELL_SIZE == 0 &&
+			header.cols > 0 && header.rows > 0;
+		// everything before the chunks has to be in the file, before any of it is allocated
+		uint64_t chunksC = ok ? (uint64_t)header.cols * (uint64_t)header.rows : 0;
+		ok = ok && header.moving_solidsC <= size / sizeof(Hitbox) && header.moving_segmentsC <= size / sizeof(Segment) &&
+			header.collidablesC <= size / sizeof(Hitbox) && chunksC <= size / sizeof(ChunkEntry) &&
+			sizeof(WorldHeader) + header.moving_solidsC * sizeof(Hitbox) + header.moving_segmentsC * sizeof(Segment) +
+			header.collidablesC * sizeof(Hitbox) + chunksC * sizeof(ChunkEntry) <= size;
+		std::vector<ChunkEntry> entries;
+		ok = ok && read_array(f, this->_solids, header.moving_solidsC) && read_array(f, this->_segments, header.moving_segmentsC) &&
+			read_array(f, this->_collidables, header.collidablesC) && read_array(f, entries, chunksC);
+		for (size_t c = 0; ok && c < entries.size(); c++)
+			ok = entries[c].offset <= size && entries[c].size <= size - entries[c].offset;
+		if (!ok)
+		{
+			fclose(f);
+			this->close();
+			return false;
+		}
+
+		this->_file = f;
+		this->_chunk_size = header.chunk_size;
+		this->_x = header.x;
+		this->_y = header.y;
+		this->_cols = header.cols;
+		this->_rows = header.rows;
+		this->_chunks.resize(entries.size());
+		for (size_t c = 0; c < entries.size(); c++)
+		{
+			const ChunkEntry& e = entries[c];
+			Chunk& chunk = this->_chunks[c];
+			chunk.offset = e.offset;
+			chunk.size = e.size;
+			chunk.x = e.x;
+			chunk.y = e.y;
+			chunk.right = e.right;
+			chunk.bottom = e.bottom;
+			chunk.indexed = false;
+			chunk.need = chunk.keep = 0;
+		}
+		this->_tick = 0;
+		return true;
+	}
+
+	template <typename F>
+	void World::near(const Hitbox& area, int grow, F f)
+	{
+		long long left = (long long)area.x - grow, top = (long long)area.y - grow;
+		long long right = (long long)area.x + area.width + grow, bottom = (long long)area.y + area.height + grow;
+		// what's near the area touches the squares of chunks it's in, and is in them
+		int col1 = std::max((int)floor_div(left - this->_x, this->_chunk_size), 0);
+		int col2 = std::min((int)floor_div(right - this->_x, this->_chunk_size), this->_cols - 1);
+		int row1 = std::max((int)floor_div(top - this->_y, this->_chunk_size), 0);
+		int row2 = std::min((int)floor_div(bottom - this->_y, this->_chunk_size), this->_rows - 1);
+		for (int row = row1; row <= row2; row++)
+		{
+			for (int col = col1; col <= col2; col++)
+			{
+				unsigned int c = (unsigned int)((size_t)row * this->_cols + col);
+				const Chunk& chunk = this->_chunks[c];
+				if (chunk.size == 0) continue;
+				if (chunk.x < right && chunk.right > left && chunk.y < bottom && chunk.bottom > top)
+					f(c);
+			}
+		}
+	}
+
+	bool World::select(const Hitbox* areas, size_t areasC)
+	{
+		if (!this->_file) return false;
+		uint64_t tick = ++this->_tick;
+		this->_next.clear();
+		for (size_t a = 0; a < areasC; a++)
+		{
+			this->near(areas[a], this->margin, [&](unsigned int c) {
+				if (this->_chunks[c].need == tick) return;
+				this->_chunks[c].need = tick;
+				this->_next.push_back(c);
+			});
+		}
+		bool changed = false;
+		for (unsigned int c : this->_next)
+			if (!this->_chunks[c].indexed) changed = true;
+		// indexed ones that nothing is near any more stay for a while
+		bool marked = false;
+		for (unsigned int c : this->_indexed)
+		{
+			Chunk& chunk = this->_chunks[c];
+			if (chunk.need == tick) continue;
+			if (!marked)
+			{
+				for (size_t a = 0; a < areasC; a++)
+					this->near(areas[a], 2 * this->margin, [&](unsigned int k) { this->_chunks[k].keep = tick; });
+				marked = true;
+			}
+			if (chunk.keep == tick)
+				this->_next.push_back(c);
+			else
+				changed = true;
+		}
+		if (!changed) return false;
+
+		// the ones that stay are needed now too, the rest of the indexed ones are left out
+		this->_changed.clear();
+		for (unsigned int c : this->_next)
+			this->_chunks[c].need = tick;
+		for (unsigned int c : this->_indexed)
+		{
+			Chunk& chunk = this->_chunks[c];
+			if (chunk.need == tick) continue;
+			chunk.indexed = false;
+			this->_changed.push_back(c);
+			if (!chunk.level.file) continue;
+			chunk.unused = this->_unused.insert(this->_unused.end(), c);
+			this->_unused_bytes += (size_t)chunk.size;
+		}
+		for (unsigned int c : this->_next)
+		{
+			Chunk& chunk = this->_chunks[c];
+			if (chunk.indexed) continue;
+			chunk.indexed = true;
+			this->_changed.push_back(c);
+			if (chunk.level.file)
+			{
+				this->_unused.erase(chunk.unused);
+				this->_unused_bytes -= (size_t)chunk.size;
+			}
+			else
+				this->load(c);
+		}
+		this->_indexed.swap(this->_next);
+		this->evict();
+
+		this->_range = {};
+		for (size_t k = 0; k < this->_indexed.size(); k++)
+		{
+			int col = (int)(this->_indexed[k] % this->_cols), row = (int)(this->_indexed[k] / this->_cols);
+			this->_range.col1 = k ? std::min(this->_range.col1, col) : col;
+			this->_range.row1 = k ? std::min(this->_range.row1, row) : row;
+			this->_range.col2 = k ? std::max(this->_range.col2, col) : col;
+			this->_range.row2 = k ? std::max(this->_range.row2, row) : row;
+		}
+		return true;
+	}
+
+	const Level* World::level(unsigned int c) const
+	{
+		const Chunk& chunk = this->_chunks[c];
+		return chunk.indexed && chunk.level.file ? &chunk.level : 0;
+	}
+
+	bool World::load(unsigned int c)
+	{
+		Chunk& chunk = this->_chunks[c];
+		int x = this->_x + (int)(c % this->_cols) * this->_chunk_size, y = this->_y + (int)(c / this->_cols) * this->_chunk_size;
+		// read into words, so the arrays of the level are aligned
+		std::shared_ptr<std::vector<uint64_t>> data = std::make_shared<std::vector<uint64_t>>((size_t)((chunk.size + 7) / 8));
+		int cells = this->_chunk_size / SolidGrid::DEFAULT_CELL_SIZE;
+		Level level;
+		if (!seek(this->_file, chunk.offset) || fread(data->data(), 1, (size_t)chunk.size, this->_file) != chunk.size ||
+			!open_level(data->data(), (size_t)chunk.size, data, level) ||
+			level.grid.cell_size() != SolidGrid::DEFAULT_CELL_SIZE || level.grid.cols() != cells || level.grid.rows() != cells ||
+			level.grid.col_x(0) != x || level.grid.row_y(0) != y)
+		{
+			this->_failed = true;
+			return false;
+		}
+		chunk.level = level;
+		this->_loaded++;
+		this->_bytes += (size_t)chunk.size;
+		this->_reads++;
+		return true;
+	}
+
+	void World::drop(Chunk& chunk)
+	{
+		this->_loaded--;
+		this->_bytes -= (size_t)chunk.size;
+		chunk.level = Level();
+	}
+
+	void World::evict()
+	{
+		while (this->_unused_bytes > this->budget && !this->_unused.empty())
+		{
+			Chunk& oldest = this->_chunks[this->_unused.front()];
+			this->_unused.pop_front();
+			this->_unused_bytes -= (size_t)oldest.size;
+			this->drop(oldest);
+		}
+	}
+}
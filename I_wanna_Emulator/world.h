@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <list>
+#include <vector>
+#include "hitbox.h"
+#include "level.h"
+
+namespace iwemu
+{
+	// a room too big to keep in memory at once, split into square chunks on disk.
+	// a chunk is a level (level.h) of every solid and segment that never moves and touches its square,
+	// with the static part of the grid over the square already built, so it's used the way it's read:
+	// nothing is merged or indexed when it comes in. something on a border is in every chunk it touches.
+	// moving ones aren't in any chunk and are always there.
+	//
+	// a scene made on a world (SolidScene(world, ...)) only has the chunks near what is in it:
+	// ones within margin of its live collidables and projectiles are read from the file, and their grids
+	// become blocks of the grid of the scene (SolidGrid::set_block()), the rest aren't looked at.
+	// movers don't need the chunks around them, since nothing they do depends on what doesn't move,
+	// unless a collidable is there too. chunks that are read stay in memory until the ones that aren't indexed
+	// take more than budget, then the ones left longest ago are dropped, and read again if they are needed again.
+	// the grid spans the squares of all of the chunks that are in, so it's for a player or a few close together:
+	// collidables far apart have a grid of everything between them, with nothing in most of it.
+	// like level files, a world file only opens on the kind of machine it was written on
+	class World
+	{
+	public:
+		// 32 cells of the grid. chunks are a whole number of cells
+		static const int DEFAULT_CHUNK_SIZE = 1024;
+		static const int DEFAULT_MARGIN = 256;
+		static const size_t DEFAULT_BUDGET = (size_t)64 << 20;
+
+		// a chunk is indexed once something is this close to what's in it, and stays indexed until
+		// nothing is twice as close, so something going back and forth over a border doesn't index it every frame.
+		// things in the scene have to move less than this in a frame
+		int margin = DEFAULT_MARGIN;
+		// bytes of chunks that aren't indexed kept in memory. indexed ones are kept whatever it is
+		size_t budget = DEFAULT_BUDGET;
+
+		// inclusive range of chunks
+		struct ChunkRange
+		{
+			int col1, row1, col2, row2;
+		};
+
+		World() {}
+		~World();
+		World(const World&) = delete;
+		World& operator=(const World&) = delete;
+
+		// opens a file made by write_world(), and reads what is always there. the file stays open
+		bool open(const char* path);
+		void close();
+
+		// where collidables start, in whole pixels
+		const std::vector<Hitbox>& collidables() const { return this->_collidables; }
+		// moving objects, in the order they were written. the rest is in the levels of the chunks
+		Hitbox* solids() { return this->_solids.data(); }
+		size_t solids_count() const { return this->_solids.size(); }
+		Segment* segments() { return this->_segments.data(); }
+		size_t segments_count() const { return this->_segments.size(); }
+
+		// picks chunks near the areas, and reads the ones that aren't in memory.
+		// true if they aren't the ones that were indexed, changed() tells which ones came and went then
+		bool select(const Hitbox* areas, size_t areasC);
+
+		// chunks are numbered row after row from the one at (x(), y())
+		int x() const { return this->_x; }
+		int y() const { return this->_y; }
+		int cols() const { return this->_cols; }
+		int rows() const { return this->_rows; }
+		int chunk_size() const { return this->_chunk_size; }
+		size_t chunk_count() const { return this->_chunks.size(); }
+		// range of chunks around the indexed ones, the first chunk if none is
+		const ChunkRange& indexed_range() const { return this->_range; }
+		const std::vector<unsigned int>& indexed() const { return this->_indexed; }
+		// chunks the last select() that returned true indexed or left out
+		const std::vector<unsigned int>& changed() const { return this->_changed; }
+		// level of chunk c if it's indexed and in memory, 0 if not
+		const Level* level(unsigned int c) const;
+
+		size_t indexed_count() const { return this->_indexed.size(); }
+		// chunks in memory, and bytes they take
+		size_t loaded_count() const { return this->_loaded; }
+		size_t loaded_bytes() const { return this->_bytes; }
+		// times a chunk was read from the file since it was opened
+		size_t reads() const { return this->_reads; }
+		// true if a chunk couldn't be read, its objects are missing then
+		bool failed() const { return this->_failed; }
+
+	private:
+		struct Chunk
+		{
+			// where its level is in the file, and borders of what's in its square. size is 0 if nothing is
+			uint64_t offset, size;
+			int x, y, right, bottom;
+			bool indexed;
+			// select() it was near an area on, and near enough to keep on
+			uint64_t need, keep;
+			// in memory if level.file is there
+			Level level;
+			// where it is in _unused, if it's in memory and not indexed
+			std::list<unsigned int>::iterator unused;
+		};
+
+		FILE* _file = 0;
+		int _chunk_size = DEFAULT_CHUNK_SIZE;
+		int _x = 0, _y = 0, _cols = 0, _rows = 0;
+		std::vector<Hitbox> _collidables;
+		std::vector<Hitbox> _solids;
+		std::vector<Segment> _segments;
+		std::vector<Chunk> _chunks;
+		std::vector<unsigned int> _indexed;
+		std::vector<unsigned int> _next;
+		std::vector<unsigned int> _changed;
+		ChunkRange _range = {};
+		// chunks in memory that aren't indexed, the one left longest ago first, and bytes they take
+		std::list<unsigned int> _unused;
+		size_t _unused_bytes = 0;
+		uint64_t _tick = 0;
+		size_t _loaded = 0, _bytes = 0, _reads = 0;
+		bool _failed = false;
+
+		// calls f(chunk) for every chunk with something within grow of area
+		template <typename F> void near(const Hitbox& area, int grow, F f);
+		// reads chunk c, and checks that its grid is the one of its square
+		bool load(unsigned int c);
+		void drop(Chunk& chunk);
+		// drops chunks that aren't indexed, oldest first, until the rest fits in the budget
+		void evict();
+	};
+
+	// "IWWD", then this, then the rest
+	const uint32_t WORLD_VERSION = 2;
+
+	// splits static objects into levels of chunk_size squares, and writes them with the moving ones.
+	// chunk_size has to be a multiple of SolidGrid::DEFAULT_CELL_SIZE
+	bool write_world(FILE* f, const Hitbox* solids, size_t solidsC, const Segment* segments, size_t segmentsC,
+		const Hitbox* collidables, size_t collidablesC, int chunk_size = World::DEFAULT_CHUNK_SIZE);
+}
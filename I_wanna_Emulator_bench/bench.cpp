@@ -0,0 +1,433 @@
+// headless benchmark. generates a room, runs players in it with scripted input
+// the same way main.cpp does, and measures how long the scene takes.
+// doesn't need raylib, see README for building it on linux.
+// usage: bench [--solids=N] [--segments=N] [--collidables=N] [--movers=RATIO]
+//              [--frames=N] [--queries=N] [--random] [--seed=N]
+//              [--stats=FILE.csv] (only when built with IWEMU_STATS)
+//              [--scenes=N] [--threads=N] (N copies of the room in a SceneBatch)
+//              [--record=FILE] [--verify=FILE] (replay log of the run, or check the run against one)
+//              [--layer] (aligned blocks go into a tile layer instead of the solids)
+//              [--bullets=N] (players shoot, up to N bullets are in the room at once. one scene only)
+//              [--projectiles] (bullets are projectiles of the scene instead of collidables)
+//              [--level=FILE] (the room is written to a level file, and the scene runs on it mapped)
+//              [--world=FILE] [--chunk=N] [--budget=BYTES] (the room is written to a world file in chunks
+//              of N pixels, and the scene streams them in around the players)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include "rooms.h"
+#include "../I_wanna_Emulator/solids.h"
+#include "../I_wanna_Emulator/player.h"
+#include "../I_wanna_Emulator/batch.h"
+#include "../I_wanna_Emulator/level.h"
+#include "../I_wanna_Emulator/world.h"
+#include "../I_wanna_Emulator/replay.h"
+
+using namespace iwemu;
+typedef std::chrono::steady_clock Clock;
+
+// input of one scripted player: holds a direction for a while, jumps now and then
+struct Script
+{
+	char h = 0;
+	int hold = 0;
+	int jump = 0;	// frames left until jump key is released
+	int djump = maxDJump;
+};
+
+static PlayerInput next_input(Script& s, Random& rnd)
+{
+	PlayerInput input = { 0, false, false };
+	if (s.hold-- <= 0)
+	{
+		s.h = (char)rnd.range(-1, 1);
+		s.hold = rnd.range(10, 60);
+	}
+	input.h = s.h;
+	if (s.jump > 0 && --s.jump == 0)
+		input.jump_released = true;
+	else if (s.jump == 0 && rnd.chance(0.05))
+	{
+		input.jump_pressed = true;
+		s.jump = rnd.range(1, 20);
+	}
+	return input;
+}
+
+// a bullet in flight, and how many frames it has left
+struct Bullet
+{
+	SolidScene::Handle handle;
+	int life;
+};
+
+static double ns_since(Clock::time_point t)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count();
+}
+
+// platforms go back and forth
+static void flip_movers(Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC)
+{
+	for (size_t i = 0; i < solidsC; i++)
+	{
+		solids[i].dx = -solids[i].dx;
+		solids[i].dy = -solids[i].dy;
+	}
+	for (size_t i = 0; i < segmentsC; i++)
+	{
+		segments[i].dx = -segments[i].dx;
+		segments[i].dy = -segments[i].dy;
+	}
+}
+
+// same as the single scene run, but on copies of the room in parallel
+static int run_batch(const RoomParams& params, const Room& room, int frames, size_t scenesC, unsigned int threads)
+{
+	Clock::time_point t = Clock::now();
+	SceneBatch batch(1,
+		room.solids.data(), room.solids.size(),
+		room.segments.data(), room.segments.size(),
+		room.collidables.data(), room.collidables.size(),
+		scenesC, threads);
+	double build_ns = ns_since(t);
+	printf("room %dx%d: %zu solids, %zu segments, %zu collidables, %.2f movers, %s\n",
+		room.width, room.height, room.solids.size(), room.segments.size(), room.collidables.size(),
+		params.movers, params.tiles ? "tiles" : "random");
+
+	// every scene has its own scripts and generator, so threads share nothing
+	std::vector<std::vector<Script>> scripts(scenesC, std::vector<Script>(room.collidables.size()));
+	std::vector<Random> rnds;
+	for (size_t i = 0; i < scenesC; i++)
+		rnds.push_back(Random((unsigned int)(params.seed * 7 + 3 + i)));
+	std::vector<size_t> deaths(scenesC, 0);
+	t = Clock::now();
+	batch.step((unsigned int)frames, [&](size_t i, SolidScene& scene, BBox* collidables)
+	{
+		if (batch.result(i).frames % 64 == 63)
+			flip_movers(batch.solids(i), room.solids.size(), batch.segments(i), room.segments.size());
+		for (size_t k = 0; k < room.collidables.size(); k++)
+		{
+			if (!scene.alive[k])
+			{
+				deaths[i]++;
+				scene.alive[k] = true;
+				collidables[k] = random_player(room, rnds[i]);
+				scene.refresh_contact(k);
+			}
+			control_player(scene.grav_dir, standing(scene, k), collidables[k], scripts[i][k].djump,
+				next_input(scripts[i][k], rnds[i]));
+		}
+	});
+	double total_ns = ns_since(t);
+
+	size_t all_deaths = 0;
+	for (size_t i = 0; i < scenesC; i++)
+		all_deaths += deaths[i];
+	printf("build:              %12.0f ns\n", build_ns);
+	printf("scenes:             %12zu on %u threads\n", scenesC, batch.threads());
+	printf("frames:             %12d (%zu deaths)\n", frames, all_deaths);
+	printf("updates per second: %12.1f\n", scenesC * frames / (total_ns * 1e-9));
+	return 0;
+}
+
+static bool arg(const char* a, const char* name, const char** value)
+{
+	size_t l = strlen(name);
+	if (strncmp(a, name, l) != 0) return false;
+	*value = a + l;
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	RoomParams params;
+	int frames = 1000;
+	int queries = 100000;
+	const char* stats_path = 0;
+	size_t scenesC = 0;
+	const char* record_path = 0;
+	const char* verify_path = 0;
+	unsigned int threads = 0;
+	bool layer = false;
+	size_t bulletsC = 0;
+	bool projectiles = false;
+	const char* level_path = 0;
+	const char* world_path = 0;
+	int chunk_size = World::DEFAULT_CHUNK_SIZE;
+	size_t budget = World::DEFAULT_BUDGET;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* v;
+		if (arg(argv[i], "--solids=", &v)) params.solidsC = strtoul(v, 0, 10);
+		else if (arg(argv[i], "--segments=", &v)) params.segmentsC = strtoul(v, 0, 10);
+		else if (arg(argv[i], "--collidables=", &v)) params.collidablesC = strtoul(v, 0, 10);
+		else if (arg(argv[i], "--movers=", &v)) params.movers = atof(v);
+		else if (arg(argv[i], "--frames=", &v)) frames = atoi(v);
+		else if (arg(argv[i], "--queries=", &v)) queries = atoi(v);
+		else if (arg(argv[i], "--seed=", &v)) params.seed = (unsigned int)strtoul(v, 0, 10);
+		else if (strcmp(argv[i], "--random") == 0) params.tiles = false;
+		else if (arg(argv[i], "--stats=", &v)) stats_path = v;
+		else if (arg(argv[i], "--scenes=", &v)) scenesC = strtoul(v, 0, 10);
+		else if (arg(argv[i], "--threads=", &v)) threads = (unsigned int)strtoul(v, 0, 10);
+		else if (arg(argv[i], "--record=", &v)) record_path = v;
+		else if (arg(argv[i], "--verify=", &v)) verify_path = v;
+		else if (strcmp(argv[i], "--layer") == 0) layer = true;
+		else if (arg(argv[i], "--bullets=", &v)) bulletsC = strtoul(v, 0, 10);
+		else if (strcmp(argv[i], "--projectiles") == 0) projectiles = true;
+		else if (arg(argv[i], "--level=", &v)) level_path = v;
+		else if (arg(argv[i], "--world=", &v)) world_path = v;
+		else if (arg(argv[i], "--chunk=", &v)) chunk_size = atoi(v);
+		else if (arg(argv[i], "--budget=", &v)) budget = strtoul(v, 0, 10);
+		else
+		{
+			fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	Room room = make_room(params);
+	if (scenesC) return run_batch(params, room, frames, scenesC, threads);
+	Random rnd(params.seed * 7 + 3);
+	Clock::time_point t = Clock::now();
+	TileLayer tiles(0, 0, room.width / TileLayer::DEFAULT_TILE_SIZE + 1, room.height / TileLayer::DEFAULT_TILE_SIZE + 1);
+	if (layer)
+	{
+		std::vector<Hitbox> rest;
+		split_tiles(tiles, room.solids.data(), room.solids.size(), rest);
+		room.solids.swap(rest);
+	}
+	// bullets go into the slab after the players, so players keep their indices
+	size_t playersC = room.collidables.size();
+	room.collidables.resize(playersC + (projectiles ? 0 : bulletsC));
+	Level level;
+	build_level(room.solids.data(), room.solids.size(), room.segments.data(), room.segments.size(), 0, 0, level);
+	if (level_path)
+	{
+		FILE* f = fopen(level_path, "wb");
+		bool written = f && write_level(f, level);
+		if (f) fclose(f);
+		// opening the file is instead of indexing the room, so that's what build time is then
+		t = Clock::now();
+		if (!written || !open_level(level_path, level))
+		{
+			fprintf(stderr, "can't write or open %s\n", level_path);
+			return 1;
+		}
+	}
+	World world;
+	if (world_path)
+	{
+		FILE* f = fopen(world_path, "wb");
+		bool written = f && write_world(f, room.solids.data(), room.solids.size(), room.segments.data(), room.segments.size(),
+			0, 0, chunk_size);
+		if (f) fclose(f);
+		t = Clock::now();
+		if (!written || !world.open(world_path))
+		{
+			fprintf(stderr, "can't write or open %s\n", world_path);
+			return 1;
+		}
+		world.budget = budget;
+	}
+	std::unique_ptr<SolidScene> made(world_path
+		? new SolidScene(world, 1, room.collidables.data(), room.collidables.size(), playersC)
+		: new SolidScene(level, 1, room.collidables.data(), room.collidables.size(), playersC));
+	SolidScene& scene = *made;
+	if (layer) scene.set_tiles(&tiles);
+	double build_ns = ns_since(t);
+#ifdef IWEMU_STATS
+	scene.stats = StatsLog((size_t)frames);
+#endif
+	printf("room %dx%d: %zu solids, %zu segments, %zu collidables, %.2f movers, %s\n",
+		room.width, room.height, room.solids.size(), room.segments.size(), playersC,
+		params.movers, params.tiles ? "tiles" : "random");
+	if (layer)
+		printf("%zu of the solids are in a tile layer\n", tiles.count());
+	if (level_path)
+		printf("the room is mapped from %s\n", level_path);
+	if (world_path)
+		printf("the room is streamed from %s in %zu chunks of %d pixels\n", world_path, world.chunk_count(), world.chunk_size());
+
+	// same seed makes the same run, so a log of it tells if the physics changed
+	ReplayLog log;
+	if (verify_path)
+	{
+		FILE* f = fopen(verify_path, "rb");
+		if (!f || !read_replay(f, log) || log.playersC != playersC)
+		{
+			fprintf(stderr, "can't read %s, or it is from another room\n", verify_path);
+			return 1;
+		}
+		fclose(f);
+	}
+	FILE* record = 0;
+	if (record_path)
+	{
+		record = fopen(record_path, "wb");
+		if (!record || !write_replay_header(record, playersC))
+		{
+			fprintf(stderr, "can't write %s\n", record_path);
+			return 1;
+		}
+	}
+	std::vector<PlayerInput> inputs(playersC);
+	long long desync = -1;
+
+	std::vector<Script> scripts(playersC);
+	double update_ns = 0.0;
+	size_t deaths = 0;
+	// bullets have a generator of their own, so the players do the same with or without them
+	Random bullet_rnd(params.seed * 11 + 5);
+	std::vector<Bullet> bullets;
+	bullets.reserve(bulletsC);
+	size_t shots = 0;
+	t = Clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		if (f % 64 == 63)
+		{
+			if (world_path)
+				flip_movers(world.solids(), world.solids_count(), world.segments(), world.segments_count());
+			else
+				flip_movers(level.solids, level.solidsC, level.segments, level.segmentsC);
+		}
+		// bullets that hit a wall, died or flew long enough are taken out, and ones gone from the scene are forgotten
+		for (size_t b = 0; b < bullets.size();)
+		{
+			long k = scene.index_of(bullets[b].handle);
+			if (k < 0 || --bullets[b].life <= 0 || !scene.alive[k] || room.collidables[k].dx == 0)
+			{
+				scene.despawn(bullets[b].handle);
+				bullets[b] = bullets.back();
+				bullets.pop_back();
+			}
+			else
+				b++;
+		}
+		// projectiles that hit something are gone already, old ones are taken out here. tag is the frame it was shot on
+		const SolidScene::ProjectileArrays& flying = scene.projectiles();
+		for (size_t i = scene.projectile_count(); i > 0; i--)
+			if (f - (int)flying.tag[i - 1] >= 60) scene.remove_projectile(i - 1);
+		for (size_t k = 0; k < playersC; k++)
+		{
+			BBox& player = room.collidables[k];
+			if (!scene.alive[k])
+			{	// respawn, like pressing W in the demo
+				deaths++;
+				scene.alive[k] = true;
+				player = random_player(room, rnd);
+				scene.refresh_contact(k);
+				scene.stream();
+			}
+			inputs[k] = next_input(scripts[k], rnd);
+			// the ground under the player is known from the last update()
+			control_player(scene.grav_dir, standing(scene, k), player, scripts[k].djump, inputs[k]);
+			if (bulletsC && bullet_rnd.chance(0.2))
+			{
+				int dir = bullet_rnd.chance(0.5) ? 1 : -1;
+				BBox bullet = { player.x + (Scalar)(player.width / 2), player.y + (Scalar)(player.height / 2), 4, 4, (Scalar)(8 * dir), 0 };
+				if (projectiles)
+				{
+					if (scene.projectile_count() < bulletsC)
+					{
+						scene.add_projectile(bullet, (unsigned int)f);
+						shots++;
+					}
+				}
+				else
+				{
+					SolidScene::Handle h = scene.spawn(bullet);
+					if (h.slot != ~0u)
+					{
+						bullets.push_back({ h, 60 });
+						shots++;
+					}
+				}
+			}
+		}
+		Clock::time_point u = Clock::now();
+		scene.update();
+		update_ns += ns_since(u);
+		if (record)
+			write_replay_frame(record, inputs.data(), inputs.size(), scene.state_hash());
+		if (verify_path && desync < 0 && ((size_t)f >= log.frames() || scene.state_hash() != log.hashes[f]))
+			desync = f;
+	}
+	if (record) fclose(record);
+	double total_ns = ns_since(t);
+	if (stats_path)
+	{
+#ifdef IWEMU_STATS
+		FILE* f = fopen(stats_path, "w");
+		if (f)
+		{
+			scene.stats.write_csv(f);
+			fclose(f);
+		}
+		else
+			fprintf(stderr, "can't write %s\n", stats_path);
+#else
+		fprintf(stderr, "built without IWEMU_STATS, --stats is ignored\n");
+#endif
+	}
+
+	// rewinding, the way rollback does it
+	SolidScene::Snapshot snap;
+	scene.save(snap);
+	t = Clock::now();
+	for (int i = 0; i < queries; i++)
+	{
+		scene.save(snap);
+		scene.restore(snap);
+	}
+	double snapshot_ns = ns_since(t);
+
+	// queries on the room as it ended up
+	std::vector<Hitbox> boxes((size_t)queries);
+	for (size_t i = 0; i < boxes.size(); i++)
+		boxes[i] = get_hitbox(random_player(room, rnd));
+	size_t hits = 0;
+	t = Clock::now();
+	for (size_t i = 0; i < boxes.size(); i++)
+		hits += scene.place_free(boxes[i]);
+	double place_ns = ns_since(t);
+	std::vector<uint64_t> free_bits((boxes.size() + 63) / 64);
+	t = Clock::now();
+	scene.place_free(boxes.data(), boxes.size(), free_bits.data());
+	double batch_ns = ns_since(t);
+	size_t batch_hits = 0;
+	for (size_t i = 0; i < boxes.size(); i++)
+		batch_hits += (free_bits[i / 64] >> (i % 64)) & 1;
+	double sum = 0.0;
+	t = Clock::now();
+	for (size_t i = 0; i < boxes.size(); i++)
+		sum += scene.project_free_down(get_bbox(boxes[i])) <= 1;
+	double project_ns = ns_since(t);
+
+	printf("build:              %12.0f ns\n", build_ns);
+	printf("frames:             %12d (%zu deaths)\n", frames, deaths);
+	if (bulletsC)
+		printf("bullets:            %12zu shot\n", shots);
+	if (world_path)
+		printf("chunks:             %12zu read (%zu indexed, %zu in memory, %zu bytes)\n",
+			world.reads(), world.indexed_count(), world.loaded_count(), world.loaded_bytes());
+	printf("frames per second:  %12.1f\n", frames / (total_ns * 1e-9));
+	printf("ns per update():    %12.1f\n", update_ns / frames);
+	printf("ns per place_free:  %12.1f (%zu free)\n", queries ? place_ns / queries : 0.0, hits);
+	printf("same, in a batch:   %12.1f (%zu free)\n", queries ? batch_ns / queries : 0.0, batch_hits);
+	printf("ns per project_down:%12.1f (%.0f grounded)\n", queries ? project_ns / queries : 0.0, sum);
+	printf("ns per save+restore:%12.1f\n", queries ? snapshot_ns / queries : 0.0);
+	if (verify_path)
+	{
+		if (desync < 0)
+			printf("verify:             same as the log for all %d frames\n", frames);
+		else
+			printf("verify:             first desync at frame %lld\n", desync);
+		return desync < 0 ? 0 : 2;
+	}
+	return 0;
+}
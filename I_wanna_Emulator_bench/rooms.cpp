@@ -0,0 +1,94 @@
+#include "rooms.h"
+
+#include <math.h>
+
+namespace iwemu
+{
+	// speed of a moving platform, never zero
+	static void make_mover(Random& rnd, int& dx, int& dy)
+	{
+		if (rnd.chance(0.5))
+			dx = rnd.chance(0.5) ? rnd.range(1, 3) : -rnd.range(1, 3);
+		else
+			dy = rnd.chance(0.5) ? rnd.range(1, 3) : -rnd.range(1, 3);
+	}
+
+	Room make_room(const RoomParams& params)
+	{
+		Random rnd(params.seed);
+		Room room;
+		// a quarter of the room is blocks, like in most fangames
+		int tiles = (int)ceil(sqrt((double)params.solidsC * 4.0 * 19.0 / 25.0));
+		int tiles_w = tiles < 25 ? 25 : tiles;
+		int tiles_h = tiles_w * 19 / 25;
+		if ((size_t)tiles_w * tiles_h < params.solidsC) tiles_h = (int)(params.solidsC / tiles_w + 1);
+		room.width = tiles_w * 32;
+		room.height = tiles_h * 32;
+
+		if (params.tiles)
+		{	// runs of blocks, so there are floors and walls to stand on
+			std::vector<bool> taken((size_t)tiles_w * tiles_h, false);
+			while (room.solids.size() < params.solidsC)
+			{
+				int tx = rnd.range(0, tiles_w - 1), ty = rnd.range(0, tiles_h - 1);
+				int run = rnd.range(1, 8);
+				bool vertical = rnd.chance(0.3);
+				for (int k = 0; k < run && room.solids.size() < params.solidsC; k++)
+				{
+					int x = vertical ? tx : tx + k, y = vertical ? ty + k : ty;
+					if (x >= tiles_w || y >= tiles_h || taken[(size_t)y * tiles_w + x]) break;
+					taken[(size_t)y * tiles_w + x] = true;
+					room.solids.push_back({ x * 32, y * 32, 32, 32, 0, 0 });
+				}
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < params.solidsC; i++)
+			{
+				room.solids.push_back({
+					rnd.range(0, room.width), rnd.range(0, room.height),
+					(unsigned int)rnd.range(8, 64), (unsigned int)rnd.range(8, 64), 0, 0
+				});
+			}
+		}
+		for (size_t i = 0; i < room.solids.size(); i++)
+		{
+			if (rnd.chance(params.movers))
+				make_mover(rnd, room.solids[i].dx, room.solids[i].dy);
+		}
+
+		for (size_t i = 0; i < params.segmentsC; i++)
+		{	// mostly one-way floors
+			Segment seg = { rnd.range(0, room.width), rnd.range(0, room.height), 32, false, true, false, 0, 0 };
+			if (params.tiles)
+			{
+				seg.x = seg.x / 32 * 32;
+				seg.y = seg.y / 32 * 32;
+				seg.length = 32 * rnd.range(1, 3);
+			}
+			else
+			{
+				seg.length = rnd.range(16, 96);
+			}
+			if (rnd.chance(0.2))
+			{	// some walls
+				seg.vertical = true;
+				seg.block_lt = rnd.chance(0.5);
+				seg.block_rb = !seg.block_lt;
+			}
+			if (rnd.chance(params.movers))
+				make_mover(rnd, seg.dx, seg.dy);
+			room.segments.push_back(seg);
+		}
+
+		for (size_t i = 0; i < params.collidablesC; i++)
+			room.collidables.push_back(random_player(room, rnd));
+		return room;
+	}
+
+	BBox random_player(const Room& room, Random& rnd)
+	{
+		return { Scalar(rnd.range(0, room.width - 11)), Scalar(rnd.range(0, room.height - 21)), 11, 21, 0, 0 };
+	}
+}
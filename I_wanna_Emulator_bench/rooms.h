@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include "../I_wanna_Emulator/hitbox.h"
+
+namespace iwemu
+{
+	// small deterministic generator, so the same seed makes the same room on every compiler
+	struct Random
+	{
+		unsigned int state;
+
+		Random(unsigned int seed) : state(seed ? seed : 1) {}
+		unsigned int next()
+		{	// xorshift32
+			this->state ^= this->state << 13;
+			this->state ^= this->state >> 17;
+			this->state ^= this->state << 5;
+			return this->state;
+		}
+		// in [a, b]
+		int range(int a, int b) { return a + (int)(this->next() % (unsigned int)(b - a + 1)); }
+		double real() { return (this->next() >> 8) / 16777216.0; }
+		bool chance(double p) { return this->real() < p; }
+	};
+
+	struct RoomParams
+	{
+		size_t solidsC = 1000;
+		size_t segmentsC = 100;
+		size_t collidablesC = 10;
+		// part of solids and segments that move
+		double movers = 0.05;
+		// blocks aligned to 32x32 grid, or random rectangles
+		bool tiles = true;
+		unsigned int seed = 1;
+	};
+
+	struct Room
+	{
+		int width, height;
+		std::vector<Hitbox> solids;
+		std::vector<Segment> segments;
+		std::vector<BBox> collidables;
+	};
+
+	Room make_room(const RoomParams& params);
+	// somewhere in the room, where a player could be
+	BBox random_player(const Room& room, Random& rnd);
+}
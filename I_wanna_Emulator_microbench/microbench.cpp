@@ -0,0 +1,204 @@
+// microbenchmarks of hitbox.h primitives and SolidScene queries.
+// every number is the best of a few runs, in ns per call, so it is stable enough
+// to compare before and after a change of the hot functions.
+// usage: microbench [--max=SOLIDS] [--filter=NAME] [--scalar] (no simd kernels)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "../I_wanna_Emulator_bench/rooms.h"
+#include "../I_wanna_Emulator/solids.h"
+#include "../I_wanna_Emulator/bitmask.h"
+#include "../I_wanna_Emulator/kernels.h"
+
+using namespace iwemu;
+typedef std::chrono::steady_clock Clock;
+
+// inputs are taken from arrays of this size, so calls can't be folded into a constant
+static const size_t INPUTS = 4096;
+static const double TARGET_NS = 20e6;
+static const int RUNS = 5;
+
+static const char* filter = 0;
+static volatile double sink;
+
+// calls f(i) for i over the inputs until enough time has passed,
+// returns the best ns per call over a few runs
+template <typename F>
+static double measure(F f)
+{
+	size_t n = INPUTS;
+	double best = 0.0;
+	for (int run = 0; run < RUNS; run++)
+	{
+		double acc = 0.0;
+		Clock::time_point t = Clock::now();
+		for (size_t i = 0; i < n; i++)
+			acc += (double)f(i & (INPUTS - 1));
+		double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count();
+		sink = acc;
+		if (run == 0 && ns < TARGET_NS / RUNS)
+		{	// first run just finds out how many calls to make
+			n = (size_t)(n * (TARGET_NS / RUNS) / (ns > 1.0 ? ns : 1.0)) + 1;
+			run--;
+			continue;
+		}
+		if (run == 0 || ns / n < best) best = ns / n;
+	}
+	return best;
+}
+
+template <typename F>
+static void report(const char* name, const char* layout, size_t solidsC, F f)
+{
+	if (filter && !strstr(name, filter)) return;
+	double ns = measure(f);
+	if (solidsC)
+		printf("%-24s %-7s %8zu %10.2f\n", name, layout, solidsC, ns);
+	else
+		printf("%-24s %-7s %8s %10.2f\n", name, layout, "-", ns);
+	fflush(stdout);
+}
+
+static void primitives()
+{
+	RoomParams params;
+	params.solidsC = INPUTS;
+	params.segmentsC = INPUTS;
+	params.collidablesC = INPUTS;
+	params.tiles = false;
+	Room room = make_room(params);
+	std::vector<Hitbox> h1 = room.solids, h2(INPUTS);
+	std::vector<BBox> b(INPUTS);
+	std::vector<BasicBBox<Fixed>> bf(INPUTS);
+	std::vector<int> dx(INPUTS), dy(INPUTS);
+	Random rnd(7);
+	for (size_t i = 0; i < INPUTS; i++)
+	{	// pairs close to each other, so every branch gets taken
+		const Hitbox& s = h1[i];
+		h2[i] = { s.x + rnd.range(-40, 40), s.y + rnd.range(-40, 40), (unsigned int)rnd.range(8, 64), (unsigned int)rnd.range(8, 64), 0, 0 };
+		double x = s.x + rnd.range(-60, 60) + rnd.real(), y = s.y + rnd.range(-60, 60) + rnd.real(), vx = rnd.real(), vy = rnd.real();
+		b[i] = { Scalar(x), Scalar(y), 11, 21, Scalar(vx), Scalar(vy) };
+		bf[i] = { Fixed(x), Fixed(y), 11, 21, Fixed(vx), Fixed(vy) };
+		dx[i] = rnd.range(-3, 3);
+		dy[i] = rnd.range(-3, 3);
+	}
+	const std::vector<Segment>& sg = room.segments;
+	const char* p = "pairs";
+
+	report("intersect(hbox, hbox)", p, 0, [&](size_t i) { return (double)intersect(h1[i], h2[i]); });
+	report("intersect(hbox, seg)", p, 0, [&](size_t i) { return (double)intersect(h1[i], sg[i]); });
+	report("project_left(hbox)", p, 0, [&](size_t i) { return project_left(b[i], h1[i]); });
+	report("project_left(seg)", p, 0, [&](size_t i) { return project_left(b[i], sg[i]); });
+	report("project_up(hbox)", p, 0, [&](size_t i) { return project_up(b[i], h1[i]); });
+	report("project_up(seg)", p, 0, [&](size_t i) { return project_up(b[i], sg[i]); });
+	report("project_right(hbox)", p, 0, [&](size_t i) { return project_right(b[i], h1[i]); });
+	report("project_right(seg)", p, 0, [&](size_t i) { return project_right(b[i], sg[i]); });
+	report("project_down(hbox)", p, 0, [&](size_t i) { return project_down(b[i], h1[i]); });
+	report("project_down(seg)", p, 0, [&](size_t i) { return project_down(b[i], sg[i]); });
+	report("get_hitbox", p, 0, [&](size_t i) { return (double)get_hitbox(b[i]).x; });
+	report("get_bbox", p, 0, [&](size_t i) { return get_bbox(h1[i]).x; });
+	// the same on fixed-point coordinates, whatever the scene is built with
+	report("project_left(hbox, fx)", p, 0, [&](size_t i) { return project_left(bf[i], h1[i]); });
+	report("project_down(seg, fx)", p, 0, [&](size_t i) { return project_down(bf[i], sg[i]); });
+	report("get_hitbox(fx)", p, 0, [&](size_t i) { return (double)get_hitbox(bf[i]).x; });
+
+	// spikes, a triangle in a 32x32 mask
+	std::vector<Bitmask> m(INPUTS), m2(INPUTS);
+	for (size_t i = 0; i < INPUTS; i++)
+	{
+		m[i] = make_bitmask({ h1[i].x, h1[i].y, 32, 32, 0, 0 });
+		for (unsigned int py = 0; py < 32; py++)
+			for (unsigned int px = 16 - py / 2; px < 16 + (py + 1) / 2; px++)
+				set_pixel(m[i], px, py, true);
+		m2[i] = m[i];
+		m2[i].x = h2[i].x;
+		m2[i].y = h2[i].y;
+	}
+	report("intersect(mask, hbox)", p, 0, [&](size_t i) { return (double)intersect(m[i], h2[i]); });
+	report("intersect(mask, mask)", p, 0, [&](size_t i) { return (double)intersect(m[i], m2[i]); });
+	RotationCache cache = make_rotation_cache(m[0], 16, 16);
+	for (size_t i = 0; i < INPUTS; i++)
+		m[i].rotation = rnd.range(0, 359);
+	report("intersect(rotated, hbox)", p, 0, [&](size_t i) { return (double)intersect(cache, m[i], h2[i]); });
+
+	SolidScene scene(1, h1.data(), 1, room.segments.data(), 1, b.data(), 1);
+	report("collision_side", p, 0, [&](size_t i) { return (double)scene.collision_side(b[i], h2[i], dx[i], dy[i]); });
+}
+
+static void queries(Room& room, const char* l)
+{
+	size_t solidsC = room.solids.size();
+	SolidScene scene(1,
+		room.solids.data(), room.solids.size(),
+		room.segments.data(), room.segments.size(),
+		room.collidables.data(), room.collidables.size());
+	const std::vector<BBox>& b = room.collidables;
+	std::vector<Hitbox> h(INPUTS);
+	for (size_t i = 0; i < INPUTS; i++)
+		h[i] = get_hitbox(b[i]);
+
+	report("place_solid", l, solidsC, [&](size_t i) { return (double)scene.place_solid(h[i]); });
+	report("place_free", l, solidsC, [&](size_t i) { return (double)scene.place_free(h[i]); });
+	report("project_free_left", l, solidsC, [&](size_t i) { return scene.project_free_left(b[i]); });
+	report("project_free_up", l, solidsC, [&](size_t i) { return scene.project_free_up(b[i]); });
+	report("project_free_right", l, solidsC, [&](size_t i) { return scene.project_free_right(b[i]); });
+	report("project_free_down", l, solidsC, [&](size_t i) { return scene.project_free_down(b[i]); });
+	// a player running and falling at full speed
+	report("sweep", l, solidsC, [&](size_t i) { return (double)scene.sweep(b[i], 3, 9).time; });
+}
+
+static void queries(size_t solidsC, bool tiles)
+{
+	RoomParams params;
+	params.solidsC = solidsC;
+	params.segmentsC = solidsC / 10;
+	params.collidablesC = INPUTS;
+	params.movers = 0.0;
+	params.tiles = tiles;
+	Room room = make_room(params);
+	queries(room, tiles ? "tiles" : "random");
+}
+
+// a pile of solids on top of each other in a small room, dozens in every cell
+static void dense_queries(size_t solidsC)
+{
+	Room room;
+	room.width = room.height = 256;
+	Random rnd(11);
+	for (size_t i = 0; i < solidsC; i++)
+		room.solids.push_back({ rnd.range(0, 224), rnd.range(0, 224), (unsigned int)rnd.range(8, 32), (unsigned int)rnd.range(8, 32), 0, 0 });
+	for (size_t i = 0; i < INPUTS; i++)
+		room.collidables.push_back(random_player(room, rnd));
+	queries(room, "dense");
+}
+
+int main(int argc, char** argv)
+{
+	size_t max = 1000000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--max=", 6) == 0) max = strtoul(argv[i] + 6, 0, 10);
+		else if (strncmp(argv[i], "--filter=", 9) == 0) filter = argv[i] + 9;
+		else if (strcmp(argv[i], "--scalar") == 0) use_simd(false);
+		else
+		{
+			fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	printf("kernels: %s\n", kernels_name());
+	printf("%-24s %-7s %8s %10s\n", "function", "layout", "solids", "ns/call");
+	primitives();
+	for (size_t n = 10; n <= max; n *= 10)
+	{
+		queries(n, true);
+		queries(n, false);
+	}
+	for (size_t n = 100; n <= max && n <= 10000; n *= 10)
+		dense_queries(n);
+	return 0;
+}
@@ -0,0 +1,851 @@
+// checks of SolidScene and hitbox.h against plain loops that do the same thing the simple way,
+// and of a scene on a world against one on the whole room.
+// prints what fails, and returns the number of failed checks.
+// usage: tests [--filter=NAME]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../I_wanna_Emulator/solids.h"
+#include "../I_wanna_Emulator/batch.h"
+#include "../I_wanna_Emulator/bitmask.h"
+#include "../I_wanna_Emulator/player.h"
+
+using namespace iwemu;
+
+static const char* filter = 0;
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+	do { if (!(cond)) { failures++; printf("%s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+// the closest solid or segment in a direction, the way the scene did it before it had a grid:
+// every solid, then every segment, and on equal distance the earlier one wins
+template <
+	Scalar (*project_function_hbox)(const BBox&, const Hitbox&),
+	Scalar (*project_function_seg)(const BBox&, const Segment&)
+>
+static Scalar linear_project(const BBox& bbox, Hitbox* solids, size_t solidsC, Segment* segments, size_t segmentsC,
+	Hitbox** hbox_p_dest, Segment** seg_p_dest)
+{
+	Scalar dist = infinity<Scalar>();
+	*hbox_p_dest = 0;
+	*seg_p_dest = 0;
+	for (size_t i = 0; i < solidsC; i++)
+	{
+		Scalar d = project_function_hbox(bbox, solids[i]);
+		if (d < dist)
+		{
+			dist = d;
+			*hbox_p_dest = solids + i;
+		}
+	}
+	for (size_t i = 0; i < segmentsC; i++)
+	{
+		Scalar d = project_function_seg(bbox, segments[i]);
+		if (d < dist)
+		{
+			dist = d;
+			*hbox_p_dest = 0;
+			*seg_p_dest = segments + i;
+		}
+	}
+	return dist;
+}
+
+// rooms where a lot of solids are at the same distance from a box: blocks on a coarse grid,
+// many of them in the same place, of zero width or height, merged into rectangles, or moving
+static void test_project_ties()
+{
+	static const char* names[] = { "left", "up", "right", "down" };
+	std::mt19937 rng(3);
+	auto range = [&](int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); };
+	for (int room = 0; room < 24; room++)
+	{
+		int step = room % 4 == 0 ? 1 : 8 << (room % 3);
+		int width = range(200, 600), height = range(200, 400);
+		std::vector<Hitbox> solids;
+		std::vector<Segment> segments;
+		for (int b = range(0, 20); b > 0; b--)
+		{	// rectangles of blocks, in no order
+			int w = step * range(1, 2), h = step * range(1, 2);
+			int x = range(0, width / step) * step, y = range(0, height / step) * step;
+			int cols = range(1, 4), rows = range(1, 4);
+			size_t first = solids.size();
+			for (int r = 0; r < rows; r++)
+				for (int c = 0; c < cols; c++)
+					solids.push_back({ x + c * w, y + r * h, (unsigned int)w, (unsigned int)h, 0, 0 });
+			std::shuffle(solids.begin() + first, solids.end(), rng);
+		}
+		for (int k = range(500, 3000); k > 0; k--)
+		{
+			Hitbox s = {
+				range(0, width / step) * step, range(0, height / step) * step,
+				(unsigned int)(range(0, 2) ? step * range(0, 2) : 0), (unsigned int)(range(0, 3) ? step * range(1, 2) : 0),
+				0, 0
+			};
+			if (room % 3 == 1 && range(0, 9) == 0)
+			{
+				s.dx = range(-2, 2);
+				s.dy = range(-2, 2);
+			}
+			solids.push_back(s);
+		}
+		for (int k = range(0, 200); k > 0; k--)
+		{
+			Segment s = {
+				range(0, width / step) * step, range(0, height / step) * step, (unsigned int)(step * range(0, 3)),
+				range(0, 1) == 1, range(0, 1) == 1, range(0, 1) == 1, 0, 0
+			};
+			segments.push_back(s);
+		}
+		BBox player = { 0, 0, 11, 21, 0, 0 };
+		SolidScene scene(1, solids.data(), solids.size(), segments.data(), segments.size(), &player, 1);
+
+		for (int q = 0; q < 1000; q++)
+		{
+			if (q % 250 == 249)
+				scene.update();
+			Scalar x = Scalar((range(0, 1) ? range(-40, width) : range(0, width / step) * step) - range(0, 3) * 0.25);
+			Scalar y = Scalar((range(0, 1) ? range(-40, height) : range(0, height / step) * step) - range(0, 3) * 0.25);
+			BBox bbox = { x, y, (unsigned int)(range(0, 5) ? range(0, 80) : 0), (unsigned int)(range(0, 5) ? range(0, 80) : 0), 0, 0 };
+			for (int dir = 0; dir < 4; dir++)
+			{
+				Hitbox* hbox1 = 0; Segment* seg1 = 0;
+				Hitbox* hbox2 = 0; Segment* seg2 = 0;
+				Scalar d1 = 0, d2 = 0;
+				Hitbox* s = solids.data();
+				Segment* g = segments.data();
+				switch (dir)
+				{
+				case 0:
+					d1 = scene.project_free_left(bbox, &hbox1, &seg1);
+					d2 = linear_project<project_left, project_left>(bbox, s, solids.size(), g, segments.size(), &hbox2, &seg2);
+					break;
+				case 1:
+					d1 = scene.project_free_up(bbox, &hbox1, &seg1);
+					d2 = linear_project<project_up, project_up>(bbox, s, solids.size(), g, segments.size(), &hbox2, &seg2);
+					break;
+				case 2:
+					d1 = scene.project_free_right(bbox, &hbox1, &seg1);
+					d2 = linear_project<project_right, project_right>(bbox, s, solids.size(), g, segments.size(), &hbox2, &seg2);
+					break;
+				default:
+					d1 = scene.project_free_down(bbox, &hbox1, &seg1);
+					d2 = linear_project<project_down, project_down>(bbox, s, solids.size(), g, segments.size(), &hbox2, &seg2);
+					break;
+				}
+				CHECK(d1 == d2 && hbox1 == hbox2 && seg1 == seg2,
+					"room %d, [%g, %g, %u, %u] %s: %g, solid %ld, segment %ld, should be %g, solid %ld, segment %ld",
+					room, (double)bbox.x, (double)bbox.y, bbox.width, bbox.height, names[dir],
+					(double)d1, hbox1 ? (long)(hbox1 - s) : -1L, seg1 ? (long)(seg1 - g) : -1L,
+					(double)d2, hbox2 ? (long)(hbox2 - s) : -1L, seg2 ? (long)(seg2 - g) : -1L);
+			}
+		}
+	}
+}
+
+// a sweep through a scene of one thing, what that thing alone does to the box
+struct SweepAlone
+{
+	BBox player = { 0, 0, 1, 1, 0, 0 };
+	std::unique_ptr<SolidScene> scene;
+};
+
+// sweeps on hand-made rooms with known answers, then sweeps of random rooms with tiles against the same
+// sweeps on a scene of each thing alone, the closest one winning, and of a few at the same time,
+// the solid of the lowest index, then a tile, then the first segment
+static void test_sweep()
+{
+	Hitbox solids[] = { { 100, 0, 20, 20, 0, 0 }, { 300, 0, 20, 20, 0, 0 }, { 300, 20, 20, 20, 0, 0 } };
+	Segment segments[] = { { 0, 192, 400, false, true, false, 0, 0 }, { 300, 0, 40, true, true, true, 0, 0 } };
+	BBox player = { 0, 0, 11, 21, 0, 0 };
+	SolidScene scene(1, solids, 3, segments, 2, &player, 1);
+	TileLayer tiles(0, 0, 20, 20);
+	tiles.set(1, 6, true);
+	scene.set_tiles(&tiles);
+	struct Case
+	{
+		BBox bbox;
+		Scalar dx, dy, time;
+		int normal_x, normal_y;
+		const Hitbox* solid;
+		const Segment* segment;
+	};
+	const Case cases[] = {
+		// a face, head on and on the way down past it
+		{ { 80, 5, 10, 10, 0, 0 }, 20, 0, Scalar(0.5), -1, 0, &solids[0], 0 },
+		{ { 105, -30, 10, 10, 0, 0 }, 10, 40, Scalar(0.5), 0, -1, &solids[0], 0 },
+		// the corner, both sides at the same time
+		{ { 80, -20, 10, 10, 0, 0 }, 20, 20, Scalar(0.5), -1, -1, &solids[0], 0 },
+		// the corner, passed by
+		{ { 80, 5, 10, 10, 0, 0 }, 20, -40, 1, 0, 0, 0, 0 },
+		// inside of it already
+		{ { 105, 5, 10, 10, 0, 0 }, 20, 0, 0, 0, 0, &solids[0], 0 },
+		// the one-way floor stops what comes from above only
+		{ { 150, 172, 10, 10, 0, 0 }, 0, 20, Scalar(0.5), 0, -1, 0, &segments[0] },
+		{ { 150, 202, 10, 10, 0, 0 }, 0, -20, 1, 0, 0, 0, 0 },
+		{ { 150, 172, 10, 10, 0, 0 }, 20, 20, Scalar(0.5), 0, -1, 0, &segments[0] },
+		// two solids at the same time, and a segment on them: the lower index
+		{ { 280, 15, 10, 10, 0, 0 }, 40, 0, Scalar(0.25), -1, 0, &solids[1], 0 },
+		// a tile and the floor at the same time: the tile
+		{ { 40, 172, 10, 10, 0, 0 }, 0, 40, Scalar(0.25), 0, -1, 0, 0 },
+	};
+	for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++)
+	{
+		const Case& c = cases[k];
+		SolidScene::Hit hit = scene.sweep(c.bbox, c.dx, c.dy);
+		CHECK(hit.time == c.time && hit.normal_x == c.normal_x && hit.normal_y == c.normal_y &&
+			hit.solid == c.solid && hit.segment == c.segment,
+			"case %zu: time %g, normal %d, %d, solid %p, segment %p", k, (double)hit.time, hit.normal_x, hit.normal_y,
+			(void*)hit.solid, (void*)hit.segment);
+	}
+
+	std::mt19937 rng(11);
+	auto range = [&](int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); };
+	for (int room = 0; room < 12; room++)
+	{
+		int step = room % 3 == 0 ? 1 : 8;
+		std::vector<Hitbox> room_solids;
+		std::vector<Segment> room_segments;
+		for (int k = range(20, 80); k > 0; k--)
+			room_solids.push_back({ range(0, 400 / step) * step, range(0, 300 / step) * step,
+				(unsigned int)(step * range(0, 4)), (unsigned int)(step * range(0, 4)), 0, 0 });
+		for (int k = range(0, 30); k > 0; k--)
+			room_segments.push_back({ range(0, 400 / step) * step, range(0, 300 / step) * step, (unsigned int)(step * range(0, 6)),
+				range(0, 1) == 1, range(0, 1) == 1, range(0, 1) == 1, 0, 0 });
+		TileLayer room_tiles(-8, 0, 14, 10);
+		std::vector<Hitbox> tile_boxes;
+		for (int k = range(0, 8); k > 0; k--)
+			room_tiles.set(range(0, 13), range(0, 9), true);
+		for (int row = 0; row < room_tiles.rows(); row++)
+			for (int col = 0; col < room_tiles.cols(); col++)
+				if (room_tiles.get(col, row)) tile_boxes.push_back(room_tiles.tile(col, row));
+		BBox room_player = { 0, 0, 11, 21, 0, 0 };
+		SolidScene whole(1, room_solids.data(), room_solids.size(), room_segments.data(), room_segments.size(), &room_player, 1);
+		whole.set_tiles(&room_tiles);
+
+		// solids, then tiles as solids, then segments
+		std::vector<SweepAlone> alone(room_solids.size() + tile_boxes.size() + room_segments.size());
+		for (size_t i = 0; i < alone.size(); i++)
+		{
+			SweepAlone& a = alone[i];
+			if (i < room_solids.size())
+				a.scene.reset(new SolidScene(1, &room_solids[i], 1, 0, 0, &a.player, 1));
+			else if (i < room_solids.size() + tile_boxes.size())
+				a.scene.reset(new SolidScene(1, &tile_boxes[i - room_solids.size()], 1, 0, 0, &a.player, 1));
+			else
+				a.scene.reset(new SolidScene(1, 0, 0, &room_segments[i - room_solids.size() - tile_boxes.size()], 1, &a.player, 1));
+		}
+		for (int q = 0; q < 2000; q++)
+		{
+			BBox bbox = {
+				Scalar(range(-40, 420) - range(0, 3) * 0.25), Scalar(range(-40, 320) - range(0, 3) * 0.25),
+				(unsigned int)range(0, 40), (unsigned int)range(0, 40), 0, 0
+			};
+			// along an axis, diagonal, and at 45 degrees, which hits corners
+			Scalar dx = range(-60, 60), dy = range(-60, 60);
+			int kind = range(0, 3);
+			if (kind == 0) dy = 0;
+			else if (kind == 1) dx = 0;
+			else if (kind == 2) dy = range(0, 1) ? dx : -dx;
+			SolidScene::Hit hit = whole.sweep(bbox, dx, dy);
+			SolidScene::Hit should = { Scalar(1), 0, 0, 0, 0 };
+			size_t winner = alone.size();
+			for (size_t i = 0; i < alone.size(); i++)
+			{
+				SolidScene::Hit h = alone[i].scene->sweep(bbox, dx, dy);
+				if (h.time < should.time)
+				{
+					should = h;
+					winner = i;
+				}
+			}
+			bool same_thing;
+			if (winner < room_solids.size())
+				same_thing = hit.solid == &room_solids[winner] && !hit.segment;
+			else if (winner < room_solids.size() + tile_boxes.size() || winner == alone.size())
+				same_thing = !hit.solid && !hit.segment;
+			else
+				same_thing = !hit.solid && hit.segment == &room_segments[winner - room_solids.size() - tile_boxes.size()];
+			CHECK(hit.time == should.time && hit.normal_x == should.normal_x && hit.normal_y == should.normal_y && same_thing,
+				"room %d, [%g, %g, %u, %u] by %g, %g: time %g, normal %d, %d, should be %g, %d, %d (thing %zu)",
+				room, (double)bbox.x, (double)bbox.y, bbox.width, bbox.height, (double)dx, (double)dy,
+				(double)hit.time, hit.normal_x, hit.normal_y, (double)should.time, should.normal_x, should.normal_y, winner);
+		}
+	}
+}
+
+// batches of boxes, of every count around a word, against place_solid and place_free one box at a time
+static void test_place_batch()
+{
+	std::mt19937 rng(12);
+	auto range = [&](int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); };
+	for (int room = 0; room < 6; room++)
+	{
+		std::vector<Hitbox> solids;
+		std::vector<Segment> segments;
+		for (int b = range(5, 15); b > 0; b--)
+		{	// rectangles of blocks, which are merged
+			int x = range(0, 20) * 32, y = range(0, 15) * 32;
+			for (int r = range(1, 4); r > 0; r--)
+				for (int c = range(1, 4); c > 0; c--)
+					solids.push_back({ x + c * 32, y + r * 32, 32, 32, 0, 0 });
+		}
+		for (int k = range(50, 300); k > 0; k--)
+		{
+			Hitbox s = { range(0, 700), range(0, 500), (unsigned int)range(0, 40), (unsigned int)range(0, 40), 0, 0 };
+			if (range(0, 9) == 0)
+			{
+				s.dx = range(-2, 2);
+				s.dy = range(-2, 2);
+			}
+			solids.push_back(s);
+		}
+		for (int k = range(0, 60); k > 0; k--)
+			segments.push_back({ range(0, 700), range(0, 500), (unsigned int)range(0, 100),
+				range(0, 1) == 1, range(0, 1) == 1, range(0, 1) == 1, 0, 0 });
+		TileLayer tiles(0, 0, 22, 16);
+		for (int k = range(0, 40) * (room % 2); k > 0; k--)
+			tiles.set(range(0, 21), range(0, 15), true);
+		BBox player = { 0, 0, 11, 21, 0, 0 };
+		SolidScene scene(1, solids.data(), solids.size(), segments.data(), segments.size(), &player, 1);
+		scene.alive[0] = false;
+		if (room % 2) scene.set_tiles(&tiles);
+
+		const size_t counts[] = { 0, 1, 2, 63, 64, 65, 127, 128, 129, 1000 };
+		std::vector<Hitbox> boxes;
+		std::vector<uint64_t> solid_bits, free_bits;
+		for (int round = 0; round < 3; round++)
+		{
+			if (round) scene.update();
+			for (size_t count : counts)
+			{
+				boxes.clear();
+				for (size_t i = 0; i < count; i++)
+				{	// far out of the room too, and some without size
+					int spread = range(0, 9) ? 750 : 3000;
+					boxes.push_back({ range(-50, spread), range(-50, spread), (unsigned int)(range(0, 4) ? range(1, 60) : 0),
+						(unsigned int)(range(0, 4) ? range(1, 60) : 0), 0, 0 });
+				}
+				// a word more than needed, to see that nothing is written past the words of the batch
+				size_t words = (count + 63) / 64;
+				solid_bits.assign(words + 1, ~(uint64_t)0);
+				free_bits.assign(words + 1, ~(uint64_t)0);
+				scene.place_solid(boxes.data(), count, solid_bits.data());
+				scene.place_free(boxes.data(), count, free_bits.data());
+				CHECK(solid_bits[words] == ~(uint64_t)0 && free_bits[words] == ~(uint64_t)0,
+					"room %d, %zu boxes: written past the batch", room, count);
+				for (size_t i = count; i < words * 64; i++)
+					CHECK(!((solid_bits[i / 64] >> (i % 64)) & 1) && !((free_bits[i / 64] >> (i % 64)) & 1),
+						"room %d, %zu boxes: bit %zu past the boxes is set", room, count, i);
+				for (size_t i = 0; i < count; i++)
+				{
+					bool solid = (solid_bits[i / 64] >> (i % 64)) & 1, free = (free_bits[i / 64] >> (i % 64)) & 1;
+					const Hitbox& b = boxes[i];
+					CHECK(solid == scene.place_solid(b) && free == scene.place_free(b),
+						"room %d, %zu boxes, box %zu [%d, %d, %u, %u]: %d, %d", room, count, i, b.x, b.y, b.width, b.height,
+						(int)solid, (int)free);
+				}
+			}
+		}
+	}
+}
+
+// a room with a floor, platforms, one-way segments and movers, for runs of scripted players
+static void make_run_room(std::mt19937& rng, std::vector<Hitbox>& solids, std::vector<Segment>& segments, std::vector<BBox>& players)
+{
+	auto range = [&](int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); };
+	for (int x = -32; x <= 800; x += 32)
+		solids.push_back({ x, 480, 32, 32, 0, 0 });
+	for (int y = 0; y < 480; y += 32)
+	{
+		solids.push_back({ -32, y, 32, 32, 0, 0 });
+		solids.push_back({ 800, y, 32, 32, 0, 0 });
+	}
+	for (int k = 0; k < 30; k++)
+		solids.push_back({ range(0, 24) * 32, range(5, 14) * 32, 32, 32, 0, 0 });
+	for (int k = 0; k < 6; k++)
+		solids.push_back({ range(0, 700), range(150, 440), 64, 16, range(0, 1) ? range(-2, 2) : 0, range(0, 1) ? range(-1, 1) : 0 });
+	for (int k = 0; k < 10; k++)
+		segments.push_back({ range(0, 700), range(150, 460), (unsigned int)range(32, 96), false, true, false,
+			k < 3 ? range(-1, 1) : 0, 0 });
+	for (int k = 0; k < 4; k++)
+		players.push_back({ Scalar(range(20, 760)), Scalar(range(100, 400)), 11, 21, 0, 0 });
+}
+
+// input of player k in scene s at a frame, held for a few frames at a time
+static PlayerInput scripted_input(size_t s, size_t k, int frame)
+{
+	uint32_t h = (uint32_t)(s * 2654435761u) ^ (uint32_t)(k * 97531u) ^ (uint32_t)((frame / 12) * 40503u);
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return { (char)((int)(h % 3) - 1), (h >> 4) % 4 == 0, (h >> 8) % 3 == 0 };
+}
+
+static void control_players(size_t s, SolidScene& scene, BBox* players, size_t playersC, int* djumps, int frame)
+{
+	for (size_t k = 0; k < playersC; k++)
+		if (scene.alive[k]) control_player(scene, players[k], djumps[k], scripted_input(s, k, frame));
+}
+
+// scenes of a batch, stepped on a few threads, against scenes of their own fed the same inputs
+static void test_batch_scenes()
+{
+	std::mt19937 rng(13);
+	std::vector<Hitbox> solids;
+	std::vector<Segment> segments;
+	std::vector<BBox> players;
+	make_run_room(rng, solids, segments, players);
+	const size_t scenesC = 6;
+	const int frames = 400;
+	SceneBatch batch(1, solids.data(), solids.size(), segments.data(), segments.size(), players.data(), players.size(), scenesC, 3);
+	std::vector<int> batch_djumps(scenesC * players.size(), maxDJump);
+	std::vector<int> batch_frames(scenesC, 0);
+	batch.step(frames, [&](size_t s, SolidScene& scene, BBox* collidables)
+	{
+		control_players(s, scene, collidables, players.size(), &batch_djumps[s * players.size()], batch_frames[s]++);
+	});
+	for (size_t s = 0; s < scenesC; s++)
+	{
+		std::vector<Hitbox> own_solids = solids;
+		std::vector<Segment> own_segments = segments;
+		std::vector<BBox> own_players = players;
+		std::vector<int> djumps(players.size(), maxDJump);
+		SolidScene scene(1, own_solids.data(), own_solids.size(), own_segments.data(), own_segments.size(),
+			own_players.data(), own_players.size());
+		for (int f = 0; f < frames; f++)
+		{
+			control_players(s, scene, own_players.data(), own_players.size(), djumps.data(), f);
+			scene.update();
+		}
+		SolidScene& other = batch.scene(s);
+		bool same = scene.state_hash() == other.state_hash() && scene.grav_dir == other.grav_dir;
+		for (size_t k = 0; k < players.size(); k++)
+		{
+			const BBox& a = own_players[k];
+			const BBox& b = batch.collidables(s)[k];
+			same = same && a.x == b.x && a.y == b.y && a.dx == b.dx && a.dy == b.dy && scene.alive[k] == other.alive[k];
+		}
+		for (size_t i = 0; i < solids.size(); i++)
+			same = same && own_solids[i].x == batch.solids(s)[i].x && own_solids[i].y == batch.solids(s)[i].y;
+		for (size_t i = 0; i < segments.size(); i++)
+			same = same && own_segments[i].x == batch.segments(s)[i].x && own_segments[i].y == batch.segments(s)[i].y;
+		CHECK(same, "scene %zu of the batch isn't the same as one of its own", s);
+	}
+}
+
+// a run restored from a snapshot, into the scene that saved it and into one sharing its index,
+// against the run the first time
+static void test_snapshot_runs()
+{
+	std::mt19937 rng(14);
+	std::vector<Hitbox> solids;
+	std::vector<Segment> segments;
+	std::vector<BBox> players;
+	make_run_room(rng, solids, segments, players);
+	std::vector<Hitbox> other_solids = solids;
+	std::vector<Segment> other_segments = segments;
+	std::vector<BBox> other_players = players;
+	std::vector<int> djumps(players.size(), maxDJump);
+	SolidScene scene(1, solids.data(), solids.size(), segments.data(), segments.size(), players.data(), players.size());
+	SolidScene other(scene, 1, other_solids.data(), other_solids.size(), other_segments.data(), other_segments.size(),
+		other_players.data(), other_players.size());
+	for (int f = 0; f < 100; f++)
+	{
+		control_players(0, scene, players.data(), players.size(), djumps.data(), f);
+		scene.update();
+	}
+	SolidScene::Snapshot snap;
+	std::vector<int> saved_djumps = djumps;
+	std::vector<BBox> start = players;
+	// what the players stand on, asked before saving, comes back with the pointers moved
+	std::vector<SolidScene::Side> sides;
+	for (size_t k = 0; k < players.size(); k++)
+		sides.push_back(scene.touching(k, Direction::DOWN));
+	scene.save(snap);
+
+	const int frames = 300;
+	std::vector<uint64_t> hashes;
+	for (int f = 0; f < frames; f++)
+	{
+		control_players(0, scene, players.data(), players.size(), djumps.data(), 100 + f);
+		scene.update();
+		hashes.push_back(scene.state_hash());
+	}
+	std::vector<BBox> end = players;
+	bool moved = false;
+	for (size_t k = 0; k < players.size(); k++)
+		moved = moved || end[k].x != start[k].x;
+	CHECK(moved, "players stood still, the runs tell nothing");
+
+	SolidScene* runs[] = { &scene, &other };
+	BBox* run_players[] = { players.data(), other_players.data() };
+	Hitbox* run_solids[] = { solids.data(), other_solids.data() };
+	for (int r = 0; r < 2; r++)
+	{
+		SolidScene& run = *runs[r];
+		CHECK(run.restore(snap), "run %d: snapshot not restored", r);
+		for (size_t k = 0; k < players.size(); k++)
+		{
+			const SolidScene::Side& side = run.contact(k).sides[(int)Direction::DOWN];
+			CHECK(side.dist == sides[k].dist && (side.solid ? side.solid - run_solids[r] : -1) ==
+				(sides[k].solid ? sides[k].solid - solids.data() : -1),
+				"run %d, player %zu: restored contact isn't the one saved", r, k);
+		}
+		djumps = saved_djumps;
+		int differs = -1;
+		for (int f = 0; f < frames && differs < 0; f++)
+		{
+			control_players(0, run, run_players[r], players.size(), djumps.data(), 100 + f);
+			run.update();
+			if (run.state_hash() != hashes[f]) differs = f;
+		}
+		CHECK(differs < 0, "run %d: restored run differs from frame %d", r, differs);
+		for (size_t k = 0; k < players.size(); k++)
+			CHECK(run_players[r][k].x == end[k].x && run_players[r][k].y == end[k].y, "run %d, player %zu ends elsewhere", r, k);
+	}
+	// after a reindex the snapshot is of another index
+	scene.reindex();
+	CHECK(!scene.restore(snap), "snapshot restored after reindex()");
+}
+
+// a box against a mask, pixel by pixel
+static bool linear_intersect(const Bitmask& mask, const Hitbox& hbox)
+{
+	for (int y = std::max(hbox.y, mask.y); y < std::min(bottom(hbox), bottom(mask)); y++)
+		for (int x = std::max(hbox.x, mask.x); x < std::min(right(hbox), right(mask)); x++)
+			if (get_pixel(mask, x - mask.x, y - mask.y)) return true;
+	return false;
+}
+
+static void test_bitmask_boxes()
+{
+	// a box of zero width at a multiple of 64 has no pixels, not the ones of the next word
+	Bitmask mask = make_bitmask({ 0, 0, 200, 4, 0, 0 });
+	set_pixel(mask, 70, 1, true);
+	int xs[] = { 64, 65, 70, 128 };
+	for (int x : xs)
+	{
+		CHECK(!intersect(mask, Hitbox({ x, 0, 0, 4, 0, 0 })), "zero width box at x %d", x);
+		CHECK(!intersect(mask, Hitbox({ x, 1, 8, 0, 0, 0 })), "zero height box at x %d", x);
+	}
+	CHECK(intersect(mask, Hitbox({ 70, 1, 1, 1, 0, 0 })), "box on the pixel");
+
+	std::mt19937 rng(8);
+	auto range = [&](int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); };
+	for (int m = 0; m < 50; m++)
+	{
+		Bitmask random = make_bitmask({ range(-100, 100), range(-100, 100), (unsigned int)range(1, 300), (unsigned int)range(1, 20), 0, 0 });
+		for (int k = range(0, 20); k > 0; k--)
+			set_pixel(random, range(0, random.width - 1), range(0, random.height - 1), true);
+		for (int k = 0; k < 500; k++)
+		{
+			Hitbox hbox = {
+				random.x + range(-70, (int)random.width + 70), random.y + range(-10, (int)random.height + 10),
+				(unsigned int)(range(0, 3) ? range(0, 140) : 0), (unsigned int)(range(0, 3) ? range(0, 10) : 0), 0, 0
+			};
+			CHECK(intersect(random, hbox) == linear_intersect(random, hbox), "mask %d, box [%d, %d, %u, %u]",
+				m, hbox.x, hbox.y, hbox.width, hbox.height);
+		}
+	}
+}
+
+// two masks, pixel by pixel
+static bool linear_intersect(const Bitmask& mask1, const Bitmask& mask2)
+{
+	for (int y = std::max(mask1.y, mask2.y); y < std::min(bottom(mask1), bottom(mask2)); y++)
+		for (int x = std::max(mask1.x, mask2.x); x < std::min(right(mask1), right(mask2)); x++)
+			if (get_pixel(mask1, x - mask1.x, y - mask1.y) && get_pixel(mask2, x - mask2.x, y - mask2.y)) return true;
+	return false;
+}
+
+// masks at every offset against each other, so their words line up every way there is
+static void test_bitmask_masks()
+{
+	std::mt19937 rng(10);
+	auto range = [&](int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); };
+	for (int m = 0; m < 200; m++)
+	{
+		Bitmask mask1 = make_bitmask({ range(-100, 100), range(-20, 20), (unsigned int)range(1, 200), (unsigned int)range(1, 12), 0, 0 });
+		Bitmask mask2 = make_bitmask({ 0, 0, (unsigned int)range(1, 200), (unsigned int)range(1, 12), 0, 0 });
+		// sparse ones mostly miss, dense ones mostly hit
+		int pixels = range(0, 1) ? range(1, 6) : range(50, 400);
+		for (int k = 0; k < pixels; k++)
+		{
+			set_pixel(mask1, range(0, mask1.width - 1), range(0, mask1.height - 1), true);
+			set_pixel(mask2, range(0, mask2.width - 1), range(0, mask2.height - 1), true);
+		}
+		for (int k = 0; k < 300; k++)
+		{
+			mask2.x = mask1.x + range(-(int)mask2.width - 2, (int)mask1.width + 2);
+			mask2.y = mask1.y + range(-(int)mask2.height - 2, (int)mask1.height + 2);
+			bool should = linear_intersect(mask1, mask2);
+			CHECK(intersect(mask1, mask2) == should && intersect(mask2, mask1) == should, "masks %d at %d, %d: should be %d",
+				m, mask2.x - mask1.x, mask2.y - mask1.y, (int)should);
+		}
+	}
+}
+
+// quarter turns of a mask in the cache, against its pixels turned one by one
+static void test_bitmask_rotation()
+{
+	// a cache that was never made leaves the mask as it is
+	Bitmask mask = make_bitmask({ 10, 20, 40, 30, 0, 0 });
+	set_pixel(mask, 5, 7, true);
+	mask.rotation = 90;
+	RotationCache none;
+	Hitbox place = rotated_hitbox(none, mask);
+	CHECK(place.x == 10 && place.y == 20 && place.width == 40 && place.height == 30, "box of a mask with no cache");
+	CHECK(intersect(none, mask, Hitbox({ 15, 27, 1, 1, 0, 0 })) && !intersect(none, mask, Hitbox({ 16, 27, 1, 1, 0, 0 })),
+		"mask with no cache");
+	CHECK(rotated(none, 90).width == 0, "rotated copy of no cache");
+
+	std::mt19937 rng(9);
+	auto range = [&](int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); };
+	for (int m = 0; m < 30; m++)
+	{
+		Bitmask random = make_bitmask({ range(-100, 100), range(-100, 100), (unsigned int)range(1, 150), (unsigned int)range(1, 40), 0, 0 });
+		int pixels = 0;
+		for (int k = range(1, 40); k > 0; k--)
+			set_pixel(random, range(0, random.width - 1), range(0, random.height - 1), true);
+		for (unsigned int v = 0; v < random.height; v++)
+			for (unsigned int u = 0; u < random.width; u++)
+				pixels += get_pixel(random, u, v);
+		int ox = range(0, random.width), oy = range(0, random.height);
+		RotationCache cache = make_rotation_cache(random, ox, oy, m % 2 ? 4 : 360);
+		for (int turn = 0; turn < 4; turn++)
+		{
+			// a few turns around, and backwards, are the same
+			random.rotation = turn * 90 + 360 * range(-2, 2);
+			const Bitmask& r = rotated(cache, random.rotation);
+			Hitbox box = rotated_hitbox(cache, random);
+			int found = 0;
+			for (unsigned int py = 0; py < r.height; py++)
+				for (unsigned int px = 0; px < r.width; px++)
+					found += get_pixel(r, px, py);
+			CHECK(found == pixels, "mask %d, turn %d: %d pixels, should be %d", m, turn, found, pixels);
+			for (unsigned int v = 0; v < random.height; v++)
+				for (unsigned int u = 0; u < random.width; u++)
+				{
+					if (!get_pixel(random, u, v)) continue;
+					// counterclockwise on screen, where y goes down, around the origin
+					int x = (int)u - ox, y = (int)v - oy;
+					for (int k = 0; k < turn; k++)
+					{
+						int t = x;
+						x = y;
+						y = -t - 1;
+					}
+					x += random.x + ox;
+					y += random.y + oy;
+					CHECK(intersect(cache, random, Hitbox({ x, y, 1, 1, 0, 0 })) &&
+						x >= box.x && y >= box.y && x < right(box) && y < bottom(box),
+						"mask %d, turn %d: pixel %u, %u isn't at %d, %d", m, turn, u, v, x, y);
+				}
+		}
+	}
+}
+
+// projectiles faster than what they fly through, against the same flight a pixel at a time
+static void test_projectile_tunnels()
+{
+	// a wall a pixel thick, a one-way floor, and a block a fast bullet only passes by the corner of
+	Hitbox solids[] = { { 100, 0, 1, 200, 0, 0 }, { 300, 300, 32, 32, 0, 0 } };
+	Segment segments[] = { { 0, 250, 400, false, true, false, 0, 0 } };
+	BBox player = { 0, 0, 11, 21, 0, 0 };
+	SolidScene scene(1, solids, 2, segments, 1, &player, 1);
+	scene.alive[0] = false;
+
+	scene.add_projectile({ 20, 50, 4, 4, 90, 0 }, 1);
+	scene.add_projectile({ 50, 220, 2, 2, 0, 70 }, 2);
+	scene.add_projectile({ 260, 330, 2, 2, 40, -40 }, 3);
+	scene.add_projectile({ 20, 150, 4, 4, 40, 0 }, 4);
+	scene.update();
+	CHECK(scene.projectile_hit_count() == 2, "%zu hits", scene.projectile_hit_count());
+	for (size_t h = 0; h < scene.projectile_hit_count(); h++)
+	{
+		const SolidScene::ProjectileHit& hit = scene.projectile_hits()[h];
+		if (hit.tag == 1)
+			CHECK(hit.solid == &solids[0] && hit.at.x == 97, "wall hit by %p at %d", (void*)hit.solid, hit.at.x);
+		else if (hit.tag == 2)
+			CHECK(hit.segment == &segments[0] && hit.at.y == 249, "floor hit by %p at %d", (void*)hit.segment, hit.at.y);
+		else
+			CHECK(false, "projectile %u hit something", hit.tag);
+	}
+	// the one that stopped short of the wall flies on into it
+	CHECK(scene.projectile_count() == 2, "%zu projectiles left", scene.projectile_count());
+	scene.update();
+	CHECK(scene.projectile_hit_count() == 1 && scene.projectile_hits()[0].tag == 4, "slow one didn't hit the wall");
+}
+
+// a file in the temporary directory, so the tests don't write into wherever they are run from
+static std::string temp_path(const char* name)
+{
+	const char* dir = getenv("TMPDIR");
+	if (!dir) dir = getenv("TEMP");
+	if (!dir) dir = getenv("TMP");
+#ifdef _WIN32
+	if (!dir) dir = ".";
+#else
+	if (!dir) dir = "/tmp";
+#endif
+	return std::string(dir) + "/" + name;
+}
+
+// a room in small chunks, with the player put in random places by hand: what is near the player
+// has to be the same as in a scene that has everything
+static void test_world_chunks()
+{
+	Scalar (*const project_hbox[4])(const BBox&, const Hitbox&) = { project_left, project_up, project_right, project_down };
+	Scalar (*const project_seg[4])(const BBox&, const Segment&) = { project_left, project_up, project_right, project_down };
+	std::mt19937 rng(5);
+	auto range = [&](int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); };
+	std::vector<Hitbox> solids;
+	std::vector<Segment> segments;
+	for (int k = 0; k < 3000; k++)
+	{	// blocks on the grid of the tiles, so they merge, and some that are long and cross chunks
+		int step = range(0, 1) ? 32 : 1;
+		solids.push_back({ range(-40, 60) * step, range(-30, 50) * step,
+			(unsigned int)(step == 32 ? 32 : range(0, 300)), (unsigned int)(step == 32 ? 32 : range(0, 40)), 0, 0 });
+	}
+	for (int k = 0; k < 300; k++)
+		segments.push_back({ range(-1200, 1900), range(-900, 1500), (unsigned int)range(0, 200),
+			range(0, 1) == 1, range(0, 1) == 1, range(0, 1) == 1, 0, 0 });
+	std::string file = temp_path("iwemu_tests_world.iww");
+	const char* path = file.c_str();
+	FILE* f = fopen(path, "wb");
+	bool written = f && write_world(f, solids.data(), solids.size(), segments.data(), segments.size(), 0, 0, 64);
+	if (f) fclose(f);
+	World world;
+	world.budget = 4096;
+	CHECK(written && world.open(path), "can't write or open %s", path);
+	if (!world.failed() && world.chunk_count())
+	{
+		BBox whole_player = { 0, 0, 11, 21, 0, 0 };
+		BBox player = whole_player;
+		SolidScene whole(1, solids.data(), solids.size(), segments.data(), segments.size(), &whole_player, 1);
+		SolidScene streamed(world, 1, &player, 1);
+		SolidScene::Snapshot first;
+		streamed.save(first);
+		for (int place = 0; place < 300; place++)
+		{
+			player.x = Scalar(range(-1300, 2000));
+			player.y = Scalar(range(-1000, 1600));
+			streamed.alive[0] = true;
+			streamed.stream();
+			for (int q = 0; q < 40; q++)
+			{
+				BBox bbox = { player.x + Scalar(range(-50, 50) - range(0, 3) * 0.25), player.y + range(-50, 50),
+					(unsigned int)range(0, 40), (unsigned int)range(0, 40), 0, 0 };
+				Hitbox hbox = get_hitbox(bbox);
+				CHECK(streamed.place_free(hbox) == whole.place_free(hbox) && streamed.place_solid(hbox) == whole.place_solid(hbox),
+					"place %d, box [%d, %d, %u, %u]", place, hbox.x, hbox.y, hbox.width, hbox.height);
+				for (int dir = 0; dir < 4; dir++)
+				{
+					Hitbox* hbox1 = 0; Segment* seg1 = 0;
+					Hitbox* hbox2 = 0; Segment* seg2 = 0;
+					Scalar max = 100, d1, d2;
+					switch (dir)
+					{
+					case 0:
+						d1 = streamed.project_free_left_within(bbox, max, &hbox1, &seg1);
+						d2 = whole.project_free_left_within(bbox, max, &hbox2, &seg2);
+						break;
+					case 1:
+						d1 = streamed.project_free_up_within(bbox, max, &hbox1, &seg1);
+						d2 = whole.project_free_up_within(bbox, max, &hbox2, &seg2);
+						break;
+					case 2:
+						d1 = streamed.project_free_right_within(bbox, max, &hbox1, &seg1);
+						d2 = whole.project_free_right_within(bbox, max, &hbox2, &seg2);
+						break;
+					default:
+						d1 = streamed.project_free_down_within(bbox, max, &hbox1, &seg1);
+						d2 = whole.project_free_down_within(bbox, max, &hbox2, &seg2);
+						break;
+					}
+					// objects of a chunk are copies, and of a few at the same distance another one can win,
+					// so what is hit only has to be of the same kind and at that distance
+					bool same = d2 <= max
+						? d1 == d2 && !hbox1 == !hbox2 && !seg1 == !seg2 &&
+							(!hbox1 || project_hbox[dir](bbox, *hbox1) == d1) && (!seg1 || project_seg[dir](bbox, *seg1) == d1)
+						: d1 > max;
+					CHECK(same, "place %d, [%g, %g, %u, %u] direction %d: %g, should be %g",
+						place, (double)bbox.x, (double)bbox.y, bbox.width, bbox.height, dir, (double)d1, (double)d2);
+				}
+			}
+		}
+		CHECK(!world.failed(), "a chunk couldn't be read");
+
+		// chunks changed since the first snapshot, it points into ones that went
+		CHECK(!streamed.restore(first), "snapshot of other chunks restored");
+		// one of these chunks is restored after the player is moved away by hand, and the chunks
+		// of where it was are streamed in again
+		SolidScene::Snapshot here;
+		player.x = whole_player.x = 300;
+		player.y = whole_player.y = 200;
+		streamed.stream();
+		whole.refresh_contact(0);
+		streamed.touching(0, Direction::DOWN);
+		streamed.save(here);
+		player.x = -1200;
+		CHECK(streamed.restore(here) && player.x == 300, "snapshot of the same chunks not restored");
+		const SolidScene::Side& down = streamed.touching(0, Direction::DOWN);
+		const SolidScene::Side& should = whole.touching(0, Direction::DOWN);
+		CHECK(down.dist == should.dist && !down.solid == !should.solid && !down.segment == !should.segment,
+			"restored contact %g, should be %g", (double)down.dist, (double)should.dist);
+		// moved away and streamed, the chunks are others now
+		player.x = -1200;
+		streamed.stream();
+		CHECK(!streamed.restore(here), "snapshot restored after its chunks went");
+	}
+	world.close();
+	remove(path);
+}
+
+struct Test
+{
+	const char* name;
+	void (*run)();
+};
+
+static const Test TESTS[] = {
+	{ "project_ties", test_project_ties },
+	{ "sweep", test_sweep },
+	{ "place_batch", test_place_batch },
+	{ "batch_scenes", test_batch_scenes },
+	{ "snapshot_runs", test_snapshot_runs },
+	{ "bitmask_boxes", test_bitmask_boxes },
+	{ "bitmask_masks", test_bitmask_masks },
+	{ "bitmask_rotation", test_bitmask_rotation },
+	{ "projectile_tunnels", test_projectile_tunnels },
+	{ "world_chunks", test_world_chunks },
+};
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "--filter=", 9)) filter = argv[i] + 9;
+		else
+		{
+			printf("unknown argument %s\n", argv[i]);
+			return 1;
+		}
+	}
+	for (const Test& test : TESTS)
+	{
+		if (filter && !strstr(test.name, filter)) continue;
+		int was = failures;
+		test.run();
+		printf("%-24s %s\n", test.name, failures == was ? "ok" : "FAILED");
+	}
+	return failures;
+}